@@ -5,15 +5,17 @@
 #-------------------------------------------------
 
 QT       += core gui opengl
-QT       += xml
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = CellsAnalyser
 TEMPLATE = app
 
 QMAKE_CXXFLAGS += -std=c++11
 
+# Temps de la croissance de région à chaque clic : qmake CONFIG+=timing
+timing: DEFINES += CELLS_TIMING
+
 SOURCES += src/main.cpp\
     src/mainwindow.cpp \
     src/apropos.cpp \
@@ -23,11 +25,20 @@ SOURCES += src/main.cpp\
     lib/qcustomplot.cpp \
     src/slicetool.cpp \
     src/player.cpp \
+    src/frameloader.cpp \
+    src/framecache.cpp \
+    src/frame.cpp \
     lib/edimageprocessor.cpp \
     src/component.cpp \
     src/population.cpp \
     src/contours.cpp \
-    lib/qmathstools.cpp
+    lib/qmathstools.cpp \
+    lib/cellcounter.cpp \
+    lib/shapedescriptor.cpp \
+    lib/fourierbatch.cpp \
+    lib/cellindex.cpp \
+    lib/celltable.cpp \
+    lib/resultjournal.cpp
 
 HEADERS  += src/include/mainwindow.h \
     src/include/apropos.h \
@@ -37,11 +48,20 @@ HEADERS  += src/include/mainwindow.h \
     lib/qcustomplot.h \
     src/include/slicetool.h \
     src/include/player.h \
+    src/include/frameloader.h \
+    src/include/framecache.h \
+    src/include/frame.h \
     lib/edimageprocessor.h \
     src/include/component.h \
     src/include/population.h \
     src/include/contours.h \
-    lib/qmathstools.h
+    lib/qmathstools.h \
+    lib/cellcounter.h \
+    lib/shapedescriptor.h \
+    lib/fourierbatch.h \
+    lib/cellindex.h \
+    lib/celltable.h \
+    lib/resultjournal.h
 
 FORMS    += ui/mainwindow.ui \
     ui/apropos.ui \
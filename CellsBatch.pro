@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Comptage de cellules en ligne de commande
+# (sans interface graphique)
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+TARGET = CellsBatch
+CONFIG   += console
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++11
+
+SOURCES += src/batch.cpp \
+    lib/cellcounter.cpp \
+    lib/resultjournal.cpp
+
+HEADERS  += lib/cellcounter.h \
+    lib/resultjournal.h
+
+OPENCV_PATH = /usr/share/opencv
+
+INCLUDEPATH  += /usr/include/opencv2
+
+LIBS     += -L$$OPENCV_PATH -lopencv_core -lopencv_imgproc -lopencv_highgui
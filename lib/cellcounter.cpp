@@ -0,0 +1,355 @@
+
+#include "lib/cellcounter.h"
+
+CellCounter::Params::Params() :
+    contrast(1.0), lumin(0),
+    threshEn(false), thresh(0), invThresh(true), threshMode(MANUAL){
+}
+
+
+/**
+ * @brief Ajoute les octets de `v` à l'empreinte FNV-1a `h`
+ */
+template<class T>
+static void
+_fnv(uint64_t& h, const T& v){
+    const unsigned char* p = (const unsigned char*)&v;
+    for (size_t i=0; i<sizeof(T); i++){
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+uint64_t
+CellCounter::Params::hash() const{
+    uint64_t h = 14695981039346656037ULL;
+    _fnv(h, contrast);
+    _fnv(h, lumin);
+    _fnv(h, threshEn);
+    // Le seuil n'a d'effet que si le seuillage est activé (et manuel)
+    _fnv(h, threshEn ? (int)threshMode : 0);
+    _fnv(h, (threshEn && threshMode == MANUAL) ? thresh : 0);
+    _fnv(h, threshEn ? invThresh : true);
+    for (size_t i=0; i<morpho.size(); i++){
+        _fnv(h, (int)morpho[i].op);
+        _fnv(h, morpho[i].size);
+        _fnv(h, morpho[i].shape);
+    }
+    return h;
+}
+
+
+CellCounter::Morpho::Morpho(MorphoOp o, int s, int sh) :
+    op(o), size(s), shape(sh){
+}
+
+
+CellCounter::CellCounter(const Params &p){
+    setParams(p);
+}
+
+
+const CellCounter::Params&
+CellCounter::params() const{
+    return _params;
+}
+
+void
+CellCounter::setParams(const Params &p){
+    _params = p;
+    linearLut(_lut, p.contrast, p.lumin);
+}
+
+
+/****************************
+ *  Traitement
+ * **************************/
+
+cv::Mat
+CellCounter::process(const cv::Mat &src) const{
+    cv::Mat img;
+    cv::Mat tmp;
+
+    cv::LUT(src, _lut, img);
+
+    if (_params.threshEn){
+        int t = _params.thresh;
+
+        // Seuil automatique : histogramme de l'image d'origine, transformé
+        // par la table (comme dans le composant Population)
+        if (_params.threshMode != MANUAL){
+            cv::Mat gray;
+            if (src.channels() == 3 || src.channels() == 4)
+                cv::cvtColor(src, gray, cv::COLOR_RGB2GRAY);
+            else
+                gray = src;
+
+            std::vector<int> hist, mapped;
+            histogram(gray, hist);
+            mapHistogram(hist, _lut, mapped);
+            t = autoThreshold(mapped, _params.threshMode, _params.invThresh, t);
+        }
+
+        threshold(img, tmp, t, _params.invThresh);
+        cv::swap(img, tmp);
+    }
+
+    for (size_t i=0; i<_params.morpho.size(); i++){
+        const Morpho& m = _params.morpho[i];
+        morpho(img, tmp, m.op, m.size, m.shape);
+        cv::swap(img, tmp);
+    }
+
+    return img;
+}
+
+
+int
+CellCounter::count(const cv::Mat &src,
+                   std::vector<std::vector<cv::Point> > *contours) const{
+    std::vector<std::vector<cv::Point> > ct;
+    int n = findCells(process(src), ct);
+
+    if (contours)  contours->swap(ct);
+    return n;
+}
+
+
+int
+CellCounter::countFile(const std::string &fileName) const{
+    cv::Mat img = cv::imread(fileName);
+    if (img.data == NULL)  return -1;
+    return count(img);
+}
+
+
+/**************************
+ * Étapes de la chaine
+ * ************************/
+
+void
+CellCounter::linearTransform(const cv::Mat &src, cv::Mat &dst,
+                             double contrast, int lumin){
+    cv::Mat lut;
+    linearLut(lut, contrast, lumin);
+    cv::LUT(src, lut, dst);
+}
+
+
+void
+CellCounter::linearLut(cv::Mat &lut, double contrast, int lumin){
+    lut.create(1, 256, CV_8U);
+
+    // Image 8 bits : 256 valeurs possibles, calculées une fois pour toutes
+    uchar* p = lut.ptr<uchar>(0);
+    for (int i=0; i<256; i++)
+        p[i] = cv::saturate_cast<uchar>(contrast * i + lumin);
+}
+
+
+void
+CellCounter::threshold(const cv::Mat &src, cv::Mat &dst, int thresh, bool inv){
+    int type = inv ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY;
+
+    cv::Mat gray;
+    if (src.channels() == 3 || src.channels() == 4)
+        cv::cvtColor(src, gray, cv::COLOR_RGB2GRAY);
+    else
+        gray = src;
+
+    cv::threshold(gray, dst, thresh, 255, type);
+}
+
+
+void
+CellCounter::histogram(const cv::Mat &gray, std::vector<int> &hist){
+    CV_Assert(gray.type() == CV_8UC1);
+
+    int h[4][256] = {{0}};
+    int rows = gray.rows, cols = gray.cols;
+    if (gray.isContinuous()){
+        cols *= rows;
+        rows = 1;
+    }
+
+    for (int y=0; y<rows; y++){
+        const uchar* p = gray.ptr<uchar>(y);
+        int x = 0;
+        for (; x+3 < cols; x+=4){
+            h[0][p[x]]++;
+            h[1][p[x+1]]++;
+            h[2][p[x+2]]++;
+            h[3][p[x+3]]++;
+        }
+        for (; x<cols; x++)
+            h[0][p[x]]++;
+    }
+
+    hist.resize(256);
+    for (int i=0; i<256; i++)
+        hist[i] = h[0][i] + h[1][i] + h[2][i] + h[3][i];
+}
+
+
+void
+CellCounter::mapHistogram(const std::vector<int> &src, const cv::Mat &lut,
+                          std::vector<int> &dst){
+    dst.assign(256, 0);
+    const uchar* l = lut.ptr<uchar>(0);
+    for (int i=0; i<256; i++)
+        dst[l[i]] += src[i];
+}
+
+
+int
+CellCounter::autoThreshold(const std::vector<int> &hist, ThreshMode mode,
+                           bool inv, int manual){
+    int t1, t2;
+    switch (mode){
+    case OTSU:
+        return otsu(hist);
+    case MULTI_OTSU:
+        // Formes sombres (seuillage inverse) : la classe la plus sombre
+        multiOtsu(hist, t1, t2);
+        return inv ? t1 : t2;
+    case TRIANGLE:
+        return triangle(hist);
+    default:
+        return manual;
+    }
+}
+
+
+int
+CellCounter::otsu(const std::vector<int> &hist){
+    double n = 0, sum = 0;
+    for (int i=0; i<256; i++){
+        n += hist[i];
+        sum += double(i) * hist[i];
+    }
+
+    int best = 0;
+    double bestVar = -1, w0 = 0, sum0 = 0;
+    for (int t=0; t<255; t++){
+        w0 += hist[t];
+        sum0 += double(t) * hist[t];
+        double w1 = n - w0;
+        if (w0 == 0)  continue;
+        if (w1 == 0)  break;
+
+        double d = sum0 / w0 - (sum - sum0) / w1;
+        double var = w0 * w1 * d * d;  // variance inter-classes (à n² près)
+        if (var > bestVar){
+            bestVar = var;
+            best = t;
+        }
+    }
+    return best;
+}
+
+
+void
+CellCounter::multiOtsu(const std::vector<int> &hist, int &t1, int &t2){
+    // Sommes cumulées : effectif et moment d'ordre 1 de [0;i]
+    double p[256], s[256];
+    double cp = 0, cs = 0;
+    for (int i=0; i<256; i++){
+        cp += hist[i];
+        cs += double(i) * hist[i];
+        p[i] = cp;
+        s[i] = cs;
+    }
+
+    // Maximiser la variance inter-classes revient à maximiser
+    // somme(S_k² / P_k) sur les trois classes [0;t1], ]t1;t2], ]t2;255]
+    t1 = 0;
+    t2 = 1;
+    double best = -1;
+    for (int a=0; a<254; a++){
+        if (p[a] == 0)  continue;
+        double c0 = s[a] * s[a] / p[a];
+
+        for (int b=a+1; b<255; b++){
+            double p1 = p[b] - p[a], p2 = p[255] - p[b];
+            if (p1 == 0)  continue;
+            if (p2 == 0)  break;
+
+            double s1 = s[b] - s[a], s2 = s[255] - s[b];
+            double v = c0 + s1 * s1 / p1 + s2 * s2 / p2;
+            if (v > best){
+                best = v;
+                t1 = a;
+                t2 = b;
+            }
+        }
+    }
+}
+
+
+int
+CellCounter::triangle(const std::vector<int> &hist){
+    int lo = 0, hi = 255, peak = 0;
+    while (lo < 255 && hist[lo] == 0)  lo++;
+    while (hi > 0 && hist[hi] == 0)    hi--;
+    if (lo >= hi)  return lo;
+
+    for (int i=lo; i<=hi; i++)
+        if (hist[i] > hist[peak])  peak = i;
+
+    // Droite du pic à l'extrémité de la plus longue queue ; le seuil est
+    // le niveau le plus éloigné sous cette droite (distance à un facteur
+    // constant près)
+    double h = hist[peak];
+    int best = peak;
+    double bestDist = 0;
+    if (peak - lo > hi - peak){
+        for (int i=lo; i<peak; i++){
+            double d = h * (i - lo) - double(peak - lo) * hist[i];
+            if (d > bestDist){
+                bestDist = d;
+                best = i;
+            }
+        }
+    }
+    else{
+        for (int i=peak+1; i<=hi; i++){
+            double d = h * (hi - i) - double(hi - peak) * hist[i];
+            if (d > bestDist){
+                bestDist = d;
+                best = i;
+            }
+        }
+    }
+    return best;
+}
+
+
+void
+CellCounter::morpho(const cv::Mat &src, cv::Mat &dst,
+                    MorphoOp op, int size, int shape){
+    cv::Point2i center = cv::Point2i(size, size);
+
+    cv::Mat kernel = cv::getStructuringElement(shape,
+                                               cv::Size(2*size+1, 2*size+1),
+                                               center);
+    if (op == ERODE)
+        cv::erode(src, dst, kernel, center);
+    else
+        cv::dilate(src, dst, kernel, center);
+}
+
+
+int
+CellCounter::findCells(const cv::Mat &src,
+                       std::vector<std::vector<cv::Point> > &contours, int mode){
+    cv::Mat img;
+
+    // findContours modifie son entrée : on travaille sur une copie
+    if (src.channels() == 3 || src.channels() == 4)
+        cv::cvtColor(src, img, cv::COLOR_RGB2GRAY);
+    else
+        src.copyTo(img);
+
+    cv::findContours(img, contours, mode, cv::CHAIN_APPROX_SIMPLE);
+    return contours.size();
+}
@@ -0,0 +1,193 @@
+#ifndef CELLCOUNTER_H
+#define CELLCOUNTER_H
+
+#include <vector>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * @brief Moteur de comptage de cellules indépendant de l'interface
+ *
+ * CellCounter reprend la chaine de traitements du composant Population
+ * (transformation linéaire → seuillage → morphologie → `findContours`)
+ * sans dépendre d'aucun widget. Une instance est configurée une fois
+ * avec un jeu de paramètres puis peut être appelée sur autant d'images
+ * que nécessaire.
+ *
+ * Les méthodes de traitement sont `const` et n'utilisent que des tampons
+ * locaux : une même instance peut donc être partagée entre plusieurs
+ * threads de traitement.
+ *
+ * @see Population
+ */
+class CellCounter {
+
+public:
+    /**
+     * @brief Opérations morphologiques appliquées après le seuillage
+     */
+    enum MorphoOp{
+        ERODE, DILATE
+    };
+
+    /**
+     * @brief Choix du seuil
+     * * MANUAL : seuil donné (`Params::thresh`)
+     * * OTSU : variance inter-classes maximale (deux classes)
+     * * MULTI_OTSU : Otsu à deux seuils (trois classes) ; les formes sont
+     *   la classe extrême du côté sélectionné par `invThresh` (la plus
+     *   sombre en seuillage inverse)
+     * * TRIANGLE : point de l'histogramme le plus éloigné de la droite
+     *   joignant le pic à l'extrémité de la plus longue queue
+     */
+    enum ThreshMode{
+        MANUAL, OTSU, MULTI_OTSU, TRIANGLE
+    };
+
+    /**
+     * @brief Une opération morphologique et son élément structurant
+     */
+    struct Morpho {
+        Morpho(MorphoOp o, int s, int sh = cv::MORPH_ELLIPSE);
+
+        MorphoOp op;
+        int size;           /**< Taille de l'élément structurant */
+        int shape;          /**< Forme de l'élément structurant @see cv::MORPH_* */
+    };
+
+    /**
+     * @brief Paramètres de la chaine de traitements
+     */
+    struct Params {
+        Params();
+
+        double contrast;    /**< Coefficient de contraste */
+        int lumin;          /**< Décalage de luminosité */
+
+        bool threshEn;      /**< Activer le seuillage */
+        int thresh;         /**< Niveau du seuil entre 0 et 255 (seuil manuel) */
+        bool invThresh;     /**< Seuillage inverse */
+        ThreshMode threshMode; /**< Seuil manuel ou calculé sur l'histogramme */
+
+        /**
+         * Opérations morphologiques, appliquées dans l'ordre
+         * après le seuillage
+         */
+        std::vector<Morpho> morpho;
+
+        /**
+         * @brief Empreinte des paramètres (FNV-1a) : deux jeux de
+         * paramètres donnant le même comptage ont la même empreinte
+         * @see ResultJournal
+         */
+        uint64_t hash() const;
+    };
+
+public:
+    explicit CellCounter(const Params& p = Params());
+
+    const Params& params() const;
+    void setParams(const Params& p);
+
+    /**
+     * @brief Applique la chaine de traitements (sans le comptage)
+     * @param src  Image source (8 bits, 1, 3 ou 4 canaux)
+     * @return l'image traitée, binaire si le seuillage est activé
+     */
+    cv::Mat process(const cv::Mat& src) const;
+
+    /**
+     * @brief Compte les cellules de l'image source
+     * @param src       Image source
+     * @param contours  [out] contours trouvés, si non nul (@see findCells)
+     * @return le nombre de cellules
+     */
+    int count(const cv::Mat& src,
+              std::vector<std::vector<cv::Point> >* contours = 0) const;
+
+    /**
+     * @brief Lit puis compte les cellules d'un fichier image
+     * @param fileName  Chemin du fichier
+     * @return le nombre de cellules, ou -1 si le fichier n'est pas lisible
+     */
+    int countFile(const std::string& fileName) const;
+
+
+    /* Étapes de la chaine, utilisables séparément */
+public:
+    /**
+     * @brief Contraste et luminosité : `dst = contrast * src + lumin`
+     */
+    static void linearTransform(const cv::Mat& src, cv::Mat& dst,
+                                double contrast, int lumin);
+
+    /**
+     * @brief Table de correspondance (1x256, CV_8U) de la transformation
+     * linéaire, à appliquer avec `cv::LUT` sur une image 8 bits
+     * (quel que soit son nombre de canaux)
+     * @see linearTransform
+     */
+    static void linearLut(cv::Mat& lut, double contrast, int lumin);
+
+    /**
+     * @brief Seuillage de l'image convertie en niveaux de gris
+     */
+    static void threshold(const cv::Mat& src, cv::Mat& dst,
+                          int thresh, bool inv);
+
+    /**
+     * @brief Histogramme (256 classes) d'une image 8 bits en niveaux de gris,
+     * en une passe.
+     *
+     * Quatre histogrammes partiels sont remplis en alternance puis
+     * sommés : deux pixels voisins de même valeur n'attendent pas
+     * l'un après l'autre l'incrément du même compteur.
+     */
+    static void histogram(const cv::Mat& gray, std::vector<int>& hist);
+
+    /**
+     * @brief Histogramme de l'image transformée par la table `lut`
+     * (@see linearLut), calculé depuis l'histogramme `src` de l'image
+     * d'origine, sans la reparcourir
+     */
+    static void mapHistogram(const std::vector<int>& src, const cv::Mat& lut,
+                             std::vector<int>& dst);
+
+    /**
+     * @brief Seuil calculé sur l'histogramme `hist` avec la méthode `mode`
+     * (`manual` si `mode` vaut MANUAL). Les pixels de niveau <= seuil
+     * forment la classe sombre (@see cv::threshold).
+     */
+    static int autoThreshold(const std::vector<int>& hist, ThreshMode mode,
+                             bool inv, int manual = 0);
+
+    static int otsu(const std::vector<int>& hist);                      /**< @see ThreshMode */
+    static void multiOtsu(const std::vector<int>& hist, int& t1, int& t2); /**< t1 < t2 */
+    static int triangle(const std::vector<int>& hist);                  /**< @see ThreshMode */
+
+    /**
+     * @brief Érosion ou dilatation par un élément structurant de taille
+     * `2*size+1` centré
+     */
+    static void morpho(const cv::Mat& src, cv::Mat& dst,
+                       MorphoOp op, int size, int shape);
+
+    /**
+     * @brief Extrait les contours des formes de l'image. Par défaut, tous
+     * les contours sont comptés, trous compris (`cv::RETR_LIST`), comme le
+     * comptage d'origine du composant Population.
+     * @param mode  mode de `cv::findContours` (`cv::RETR_EXTERNAL` : formes
+     *              seules, sans leurs trous)
+     * @return le nombre de contours trouvés
+     */
+    static int findCells(const cv::Mat& src,
+                         std::vector<std::vector<cv::Point> >& contours,
+                         int mode = cv::RETR_LIST);
+
+protected:
+    Params _params;
+    cv::Mat _lut;   /**< Transformation linéaire de `_params` @see linearLut */
+};
+
+#endif // CELLCOUNTER_H
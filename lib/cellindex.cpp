@@ -0,0 +1,305 @@
+
+#include <math.h>
+#include <algorithm>
+
+#include "lib/cellindex.h"
+
+
+CellIndex::CellIndex() :
+    _dim(0), _probeNb(8), _trainedSize(0){
+}
+
+
+int
+CellIndex::dim() const{
+    return _dim;
+}
+
+int
+CellIndex::size() const{
+    return _frames.size();
+}
+
+bool
+CellIndex::approximate() const{
+    return !_lists.empty();
+}
+
+
+void
+CellIndex::clear(){
+    _dim = 0;
+    _data.clear();
+    _frames.clear();
+    _pos.clear();
+    _stats.clear();
+    _centers.release();
+    _scale.clear();
+    _lists.clear();
+    _trainedSize = 0;
+}
+
+
+bool
+CellIndex::add(int frame, const cv::Point2i& pos, const std::vector<double>& desc){
+    if (desc.empty())  return false;
+    if (_dim == 0){
+        _dim = desc.size();
+        _stats.assign(_dim, QMathsTools::Stats());
+    }
+    if ((int)desc.size() != _dim)  return false;
+
+    for (int j=0; j<_dim; j++){
+        _data.push_back((float)desc[j]);
+        _stats[j].add(desc[j]);
+    }
+    _frames.push_back(frame);
+    _pos.push_back(pos);
+
+    if (approximate())
+        assign(size() - 1);
+    return true;
+}
+
+
+void
+CellIndex::removeFrame(int frame){
+    // Compactage en place des entrées conservées ; `moved[i]` est le
+    // nouvel indice de l'entrée i (-1 si elle est retirée)
+    std::vector<int> moved(size(), -1);
+    int n = 0;
+    for (int i=0; i<size(); i++){
+        if (_frames[i] == frame)  continue;
+        if (n != i){
+            std::copy(_data.begin() + i * _dim, _data.begin() + (i+1) * _dim,
+                      _data.begin() + n * _dim);
+            _frames[n] = _frames[i];
+            _pos[n] = _pos[i];
+        }
+        moved[i] = n++;
+    }
+    if (n == size())  return;
+
+    _data.resize(n * _dim);
+    _frames.resize(n);
+    _pos.resize(n);
+    updateStats();
+
+    // Les groupes ne changent pas : seuls les indices sont renumérotés
+    for (size_t l=0; l<_lists.size(); l++){
+        std::vector<int>& list = _lists[l];
+        int m = 0;
+        for (size_t e=0; e<list.size(); e++)
+            if (moved[list[e]] >= 0)
+                list[m++] = moved[list[e]];
+        list.resize(m);
+    }
+}
+
+
+bool
+CellIndex::trainIfNeeded(){
+    if (size() < APPROX_MIN)  return false;
+    if (approximate() && size() <= 2 * _trainedSize)  return false;
+
+    train(0, _probeNb);
+    return true;
+}
+
+
+/****************************
+ *  Recherche
+ * **************************/
+
+std::vector<CellIndex::Match>
+CellIndex::search(const std::vector<double>& query, int k) const{
+    // Les groupes ne sont jamais calculés ici @see trainIfNeeded
+    if (size() < APPROX_MIN || !approximate())
+        return exactSearch(query, k);
+
+    std::vector<float> q, w;
+    prepare(query, q, w);
+    if (q.empty())  return std::vector<Match>();
+
+    // Groupes les plus proches de la requête (dans l'espace des centres)
+    std::vector<float> qs(_dim);
+    for (int j=0; j<_dim; j++)
+        qs[j] = q[j] * _scale[j];
+
+    std::vector<std::pair<float,int> > lists(_centers.rows);
+    for (int l=0; l<_centers.rows; l++){
+        const float* c = _centers.ptr<float>(l);
+        float d = 0;
+        for (int j=0; j<_dim; j++)
+            d += (qs[j] - c[j]) * (qs[j] - c[j]);
+        lists[l] = std::make_pair(d, l);
+    }
+    int probe = std::min<int>(_probeNb, lists.size());
+    std::partial_sort(lists.begin(), lists.begin() + probe, lists.end());
+
+    std::vector<int> ids;
+    for (int p=0; p<probe; p++){
+        const std::vector<int>& l = _lists[lists[p].second];
+        ids.insert(ids.end(), l.begin(), l.end());
+    }
+
+    std::vector<float> dist;
+    distances(&q[0], &w[0], &ids, dist);
+    return select(dist, &ids, k);
+}
+
+
+std::vector<CellIndex::Match>
+CellIndex::exactSearch(const std::vector<double>& query, int k) const{
+    std::vector<float> q, w;
+    prepare(query, q, w);
+    if (q.empty())  return std::vector<Match>();
+
+    std::vector<float> dist;
+    distances(&q[0], &w[0], 0, dist);
+    return select(dist, 0, k);
+}
+
+
+void
+CellIndex::train(int listNb, int probeNb){
+    int n = size();
+    if (n == 0)  return;
+
+    if (listNb <= 0)
+        listNb = (int)sqrt((double)n);
+    listNb = std::max(1, std::min(listNb, n));
+    _probeNb = std::max(1, probeNb);
+
+    // Espace normalisé : chaque dimension divisée par son écart-type
+    _scale.assign(_dim, 1.f);
+    for (int j=0; j<_dim; j++){
+        double v = _stats[j].variance();
+        _scale[j] = (v > 0) ? (float)(1.0 / sqrt(v)) : 0.f;
+    }
+
+    // Les k-moyennes sont calculées sur un échantillon régulier
+    int sampleNb = std::min(n, 64 * listNb);
+    cv::Mat sample(sampleNb, _dim, CV_32F);
+    for (int s=0; s<sampleNb; s++){
+        const float* v = &_data[(size_t)(s * (double)n / sampleNb) * _dim];
+        float* d = sample.ptr<float>(s);
+        for (int j=0; j<_dim; j++)
+            d[j] = v[j] * _scale[j];
+    }
+
+    cv::Mat labels;
+    cv::kmeans(sample, listNb, labels,
+               cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 20, 1e-3),
+               1, cv::KMEANS_PP_CENTERS, _centers);
+
+    _lists.assign(_centers.rows, std::vector<int>());
+    for (int i=0; i<n; i++)
+        assign(i);
+    _trainedSize = n;
+}
+
+
+/****************************
+ *  Outils
+ * **************************/
+
+void
+CellIndex::prepare(const std::vector<double>& query,
+                   std::vector<float>& q, std::vector<float>& w) const{
+    q.clear();
+    w.clear();
+    if (_dim == 0 || (int)query.size() != _dim)  return;
+
+    q.resize(_dim);
+    w.resize(_dim);
+    for (int j=0; j<_dim; j++){
+        double v = _stats[j].variance();
+        q[j] = (float)query[j];
+        w[j] = (v > 0) ? (float)(1.0 / v) : 0.f; // dimension constante : ignorée
+    }
+}
+
+
+void
+CellIndex::distances(const float* q, const float* w, const std::vector<int>* ids,
+                     std::vector<float>& dist) const{
+    int n = ids ? ids->size() : size();
+    dist.resize(n);
+
+    // Boucle interne sans branchement sur des float contigus : vectorisée
+    const int dim = _dim;
+    for (int i=0; i<n; i++){
+        const float* v = &_data[(size_t)(ids ? (*ids)[i] : i) * dim];
+        float d = 0.f;
+        for (int j=0; j<dim; j++){
+            float e = q[j] - v[j];
+            d += w[j] * e * e;
+        }
+        dist[i] = d;
+    }
+}
+
+
+std::vector<CellIndex::Match>
+CellIndex::select(std::vector<float>& dist, const std::vector<int>* ids, int k) const{
+    int n = dist.size();
+    k = std::max(0, std::min(k, n));
+
+    std::vector<int> order(n);
+    for (int i=0; i<n; i++)  order[i] = i;
+
+    // Sélection des k plus petites, puis tri de ces k seulement
+    struct Less {
+        const std::vector<float>& d;
+        Less(const std::vector<float>& dist) : d(dist) {}
+        bool operator()(int a, int b) const { return d[a] < d[b]; }
+    };
+    if (k < n)
+        std::nth_element(order.begin(), order.begin() + k, order.end(), Less(dist));
+    std::sort(order.begin(), order.begin() + k, Less(dist));
+
+    std::vector<Match> res(k);
+    for (int r=0; r<k; r++){
+        int i = ids ? (*ids)[order[r]] : order[r];
+        res[r].frame = _frames[i];
+        res[r].pos = _pos[i];
+        res[r].dist = sqrt(dist[order[r]]);
+    }
+    return res;
+}
+
+
+int
+CellIndex::nearestList(const float* v) const{
+    int best = 0;
+    float bestDist = 0;
+    for (int l=0; l<_centers.rows; l++){
+        const float* c = _centers.ptr<float>(l);
+        float d = 0;
+        for (int j=0; j<_dim; j++){
+            float e = v[j] * _scale[j] - c[j];
+            d += e * e;
+        }
+        if (l == 0 || d < bestDist){
+            best = l;
+            bestDist = d;
+        }
+    }
+    return best;
+}
+
+
+void
+CellIndex::assign(int i){
+    _lists[nearestList(&_data[(size_t)i * _dim])].push_back(i);
+}
+
+
+void
+CellIndex::updateStats(){
+    _stats.assign(_dim, QMathsTools::Stats());
+    for (int i=0; i<size(); i++)
+        for (int j=0; j<_dim; j++)
+            _stats[j].add(_data[(size_t)i * _dim + j]);
+}
@@ -0,0 +1,135 @@
+#ifndef CELLINDEX_H
+#define CELLINDEX_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "lib/qmathstools.h"
+
+
+/**
+ * @brief Index en mémoire des descripteurs de cellules, pour la recherche
+ * des k cellules les plus proches d'une cellule donnée.
+ *
+ * Chaque entrée associe un vecteur de descripteurs (de dimension fixée
+ * par la première insertion) à une image et une position dans l'image.
+ * Les vecteurs sont rangés à la suite dans un seul tableau de float.
+ *
+ * La distance est euclidienne, chaque dimension étant divisée par son
+ * écart-type sur l'ensemble de l'index : les descripteurs d'ordres de
+ * grandeur différents (variance de la signature, nombre de pics,
+ * harmoniques, invariants de Hu) pèsent autant.
+ *
+ * Deux recherches :
+ * * exacte : calcul de toutes les distances, en une boucle que le
+ *   compilateur vectorise, puis sélection des k plus petites
+ * * approchée (fichiers inversés) : les entrées sont réparties entre
+ *   `listNb` groupes par k-moyennes ; seuls les `probeNb` groupes les plus
+ *   proches de la requête sont parcourus.
+ *
+ * La recherche approchée est utilisée dès que l'index dépasse
+ * `APPROX_MIN` entrées et que les groupes sont calculés. Le calcul
+ * (k-moyennes) n'est jamais fait par la recherche : `trainIfNeeded` est
+ * appelée après les insertions, et recalcule les groupes lorsque l'index
+ * a doublé depuis le dernier calcul.
+ */
+class CellIndex {
+
+public:
+    /** Taille à partir de laquelle la recherche est approchée */
+    static const int APPROX_MIN = 20000;
+
+    /**
+     * @brief Résultat d'une recherche
+     */
+    struct Match {
+        int frame;          /**< Image de la cellule */
+        cv::Point2i pos;    /**< Position de la cellule dans l'image */
+        float dist;         /**< Distance (normalisée) à la requête */
+    };
+
+public:
+    CellIndex();
+
+    int dim() const;        /**< Dimension des descripteurs (0 si vide) */
+    int size() const;       /**< Nombre d'entrées */
+    bool approximate() const; /**< Les groupes de la recherche approchée sont calculés */
+
+    void clear();
+
+    /**
+     * @brief Ajoute une cellule
+     * @return faux si `desc` n'a pas la dimension de l'index
+     */
+    bool add(int frame, const cv::Point2i& pos, const std::vector<double>& desc);
+
+    /**
+     * @brief Retire toutes les cellules de l'image `frame` (les groupes
+     * sont conservés)
+     */
+    void removeFrame(int frame);
+
+    /**
+     * @brief Calcule les groupes de la recherche approchée si l'index
+     * dépasse `APPROX_MIN` entrées et n'en a pas, ou a doublé depuis le
+     * dernier calcul
+     * @return vrai si les groupes ont été calculés
+     */
+    bool trainIfNeeded();
+
+    /**
+     * @brief Les `k` cellules les plus proches de `query`, de la plus
+     * proche à la plus lointaine (recherche approchée si les groupes
+     * sont calculés, @see trainIfNeeded)
+     */
+    std::vector<Match> search(const std::vector<double>& query, int k) const;
+
+    /**
+     * @brief Les `k` cellules les plus proches de `query`, en parcourant
+     * tout l'index
+     */
+    std::vector<Match> exactSearch(const std::vector<double>& query, int k) const;
+
+    /**
+     * @brief Calcule les groupes de la recherche approchée
+     * @param listNb   nombre de groupes (racine du nombre d'entrées si <= 0)
+     * @param probeNb  nombre de groupes parcourus par recherche
+     */
+    void train(int listNb = 0, int probeNb = 8);
+
+protected:
+    /**
+     * @brief Poids des dimensions (inverse de la variance), et requête
+     * convertie en float
+     */
+    void prepare(const std::vector<double>& query,
+                 std::vector<float>& q, std::vector<float>& w) const;
+
+    /** Distances de la requête aux entrées `ids` (toutes si `ids` est nul) */
+    void distances(const float* q, const float* w, const std::vector<int>* ids,
+                   std::vector<float>& dist) const;
+
+    /** Les k plus petites distances de `dist` (entrées `ids`, ou toutes) */
+    std::vector<Match> select(std::vector<float>& dist, const std::vector<int>* ids, int k) const;
+
+    /** Groupe le plus proche du vecteur normalisé `v` */
+    int nearestList(const float* v) const;
+
+    void assign(int i);     /**< Range l'entrée `i` dans son groupe */
+    void updateStats();     /**< Recalcule `_stats` sur toutes les entrées */
+
+protected:
+    int _dim;
+    std::vector<float> _data;           /**< Descripteurs, `_dim` valeurs par entrée */
+    std::vector<int> _frames;           /**< Image de chaque entrée */
+    std::vector<cv::Point2i> _pos;      /**< Position de chaque entrée */
+    std::vector<QMathsTools::Stats> _stats; /**< Statistiques de chaque dimension */
+
+    cv::Mat _centers;                   /**< Centres des groupes (CV_32F, espace normalisé) */
+    std::vector<float> _scale;          /**< Normalisation utilisée pour les centres */
+    std::vector<std::vector<int> > _lists; /**< Entrées de chaque groupe */
+    int _probeNb;                       /**< Groupes parcourus par recherche */
+    int _trainedSize;                   /**< Taille de l'index au dernier calcul des groupes */
+};
+
+#endif // CELLINDEX_H
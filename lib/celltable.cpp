@@ -0,0 +1,294 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+#include "lib/celltable.h"
+
+using namespace CellTable;
+
+static const char MAGIC[8] = "CELLTAB";
+static const uint32_t ORDER_MARK = 0x01020304;
+static const uint32_t FORMAT_VERSION = 1;
+static const qint64 COLUMN_ALIGN = 64;
+
+
+/****************************
+ *  Écriture
+ * **************************/
+
+Writer::Writer(int harmNb, int fourierLength) :
+    _harmNb(harmNb < 0 ? 0 : harmNb),
+    _fourierLength(fourierLength),
+    _harm(_harmNb){
+}
+
+
+int
+Writer::rows() const{
+    return _frame.size();
+}
+
+
+void
+Writer::append(int frame, int cell, const ShapeDescriptor::Cell& c){
+    _frame.push_back(frame);
+    _cell.push_back(cell);
+    _x.push_back(c.centroid.x);
+    _y.push_back(c.centroid.y);
+    _area.push_back(c.area);
+    _variance.push_back(c.polar.size() > 0 ? c.polar[0] : 0.0);
+    _peaks.push_back(c.polar.size() > 1 ? c.polar[1] : 0.0);
+    for (int k=0; k<_harmNb; k++)
+        _harm[k].push_back(k < (int)c.fourier.size() ? c.fourier[k] : 0.0);
+}
+
+
+void
+Writer::clear(){
+    _frame.clear();  _cell.clear();  _x.clear();  _y.clear();
+    _area.clear();  _variance.clear();  _peaks.clear();
+    for (int k=0; k<_harmNb; k++)
+        _harm[k].clear();
+}
+
+
+/**
+ * @brief Colonne à écrire
+ */
+struct _OutColumn {
+    _OutColumn(const char* n, Type t, const void* d) : name(n), type(t), data(d) {}
+
+    std::string name;
+    Type type;
+    const void* data;
+};
+
+
+bool
+Writer::write(const QString& fileName) const{
+    std::vector<_OutColumn> cols;
+    cols.push_back(_OutColumn("frame", INT32, _frame.data()));
+    cols.push_back(_OutColumn("cell", INT32, _cell.data()));
+    cols.push_back(_OutColumn("x", INT32, _x.data()));
+    cols.push_back(_OutColumn("y", INT32, _y.data()));
+    cols.push_back(_OutColumn("aire", FLOAT64, _area.data()));
+    cols.push_back(_OutColumn("variance", FLOAT64, _variance.data()));
+    cols.push_back(_OutColumn("pics", FLOAT64, _peaks.data()));
+    for (int k=0; k<_harmNb; k++){
+        char name[16];
+        snprintf(name, sizeof(name), "harm%d", k);
+        cols.push_back(_OutColumn(name, FLOAT64, _harm[k].data()));
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(h.magic));
+    h.byteOrder = ORDER_MARK;
+    h.version = FORMAT_VERSION;
+    h.rows = rows();
+    h.harmNb = _harmNb;
+    h.columnNb = cols.size();
+    h.fourierLength = _fourierLength;
+
+    // Répertoire : position de chaque colonne, alignée
+    std::vector<Column> dir(cols.size());
+    qint64 offset = sizeof(Header) + cols.size() * sizeof(Column);
+    for (size_t i=0; i<cols.size(); i++){
+        offset = (offset + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+        memset(&dir[i], 0, sizeof(Column));
+        strncpy(dir[i].name, cols[i].name.c_str(), sizeof(dir[i].name) - 1);
+        dir[i].type = cols[i].type;
+        dir[i].offset = offset;
+        offset += h.rows * (cols[i].type == INT32 ? sizeof(int32_t) : sizeof(double));
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))  return false;
+
+    bool ok = file.write((const char*)&h, sizeof(h)) == sizeof(h);
+    ok = ok && file.write((const char*)dir.data(), dir.size() * sizeof(Column))
+               == qint64(dir.size() * sizeof(Column));
+
+    static const char zeros[COLUMN_ALIGN] = {0};
+    for (size_t i=0; ok && i<cols.size(); i++){
+        qint64 pad = dir[i].offset - file.pos();
+        ok = file.write(zeros, pad) == pad;
+
+        qint64 bytes = h.rows * (cols[i].type == INT32 ? sizeof(int32_t) : sizeof(double));
+        ok = ok && file.write((const char*)cols[i].data, bytes) == bytes;
+    }
+
+    file.close();
+    return ok;
+}
+
+
+/****************************
+ *  Lecture
+ * **************************/
+
+Reader::Reader() :
+    _map(0), _size(0), _header(0), _columns(0){
+}
+
+Reader::~Reader(){
+    close();
+}
+
+
+bool
+Reader::open(const QString& fileName){
+    close();
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly))  return false;
+
+    _size = _file.size();
+    if (_size >= (qint64)sizeof(Header))
+        _map = _file.map(0, _size);
+    if (!_map){
+        close();
+        return false;
+    }
+
+    _header = (const Header*)_map;
+    _columns = (const Column*)(_map + sizeof(Header));
+
+    bool ok = memcmp(_header->magic, MAGIC, sizeof(MAGIC)) == 0
+           && _header->byteOrder == ORDER_MARK
+           && _header->version == FORMAT_VERSION
+           && (qint64)(sizeof(Header) + _header->columnNb * sizeof(Column)) <= _size;
+
+    // Chaque colonne doit tenir dans le fichier
+    for (uint32_t i=0; ok && i<_header->columnNb; i++){
+        const Column& c = _columns[i];
+        uint64_t width = (c.type == INT32) ? sizeof(int32_t) : sizeof(double);
+        ok = (c.type == INT32 || c.type == FLOAT64)
+          && c.offset % COLUMN_ALIGN == 0
+          && c.offset + _header->rows * width <= (uint64_t)_size;
+    }
+
+    if (!ok){
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void
+Reader::close(){
+    if (_map)
+        _file.unmap(const_cast<uchar*>(_map));
+    if (_file.isOpen())
+        _file.close();
+    _map = 0;
+    _size = 0;
+    _header = 0;
+    _columns = 0;
+}
+
+
+bool
+Reader::isOpen() const{
+    return _header != 0;
+}
+
+
+uint64_t
+Reader::rows() const{
+    return _header ? _header->rows : 0;
+}
+
+int
+Reader::harmNb() const{
+    return _header ? _header->harmNb : 0;
+}
+
+int
+Reader::fourierLength() const{
+    return _header ? _header->fourierLength : 0;
+}
+
+int
+Reader::columnNb() const{
+    return _header ? _header->columnNb : 0;
+}
+
+const Column&
+Reader::column(int i) const{
+    return _columns[i];
+}
+
+
+int
+Reader::columnIndex(const char* name) const{
+    for (int i=0; i<columnNb(); i++)
+        if (strncmp(_columns[i].name, name, sizeof(_columns[i].name)) == 0)
+            return i;
+    return -1;
+}
+
+
+const void*
+Reader::data(const char* name, Type type) const{
+    int i = columnIndex(name);
+    if (i < 0 || _columns[i].type != (uint32_t)type)  return 0;
+    return _map + _columns[i].offset;
+}
+
+const int32_t*
+Reader::int32Column(const char* name) const{
+    return (const int32_t*)data(name, INT32);
+}
+
+const double*
+Reader::float64Column(const char* name) const{
+    return (const double*)data(name, FLOAT64);
+}
+
+
+const int32_t*
+Reader::frames() const{
+    return int32Column("frame");
+}
+
+const int32_t*
+Reader::cells() const{
+    return int32Column("cell");
+}
+
+const int32_t*
+Reader::x() const{
+    return int32Column("x");
+}
+
+const int32_t*
+Reader::y() const{
+    return int32Column("y");
+}
+
+const double*
+Reader::area() const{
+    return float64Column("aire");
+}
+
+const double*
+Reader::variance() const{
+    return float64Column("variance");
+}
+
+const double*
+Reader::peaks() const{
+    return float64Column("pics");
+}
+
+
+const double*
+Reader::harmonic(int k) const{
+    if (k < 0 || k >= harmNb())  return 0;
+    char name[16];
+    snprintf(name, sizeof(name), "harm%d", k);
+    return float64Column(name);
+}
@@ -0,0 +1,149 @@
+#ifndef CELLTABLE_H
+#define CELLTABLE_H
+
+#include <vector>
+#include <stdint.h>
+#include <QString>
+#include <QFile>
+
+#include "lib/shapedescriptor.h"
+
+
+/**
+ *  Fichier binaire de mesures par cellule, rangées par colonnes.
+ *
+ *  Le fichier peut être projeté en mémoire (mmap) : une colonne est un
+ *  tableau contigu de valeurs, lisible sans analyse ni copie.
+ *
+ *  Structure (ordre des octets de la machine, vérifié à l'ouverture) :
+ *  * en-tête de 64 octets (@see CellTable::Header)
+ *  * répertoire des colonnes, 32 octets par colonne (@see CellTable::Column)
+ *  * données des colonnes, chacune alignée sur 64 octets
+ *
+ *  Colonnes, dans cet ordre :
+ *  * `frame`, `cell` (int32) : image et numéro de la cellule dans l'image
+ *  * `x`, `y` (int32) : centre de gravité
+ *  * `aire` (float64)
+ *  * `variance`, `pics` (float64) : signature polaire
+ *  * `harm0` ... `harm<N-1>` (float64) : `harm<k>` est le module de
+ *    l'harmonique k+1 divisé par `fourierLength` @see FourierBatch
+ */
+namespace CellTable {
+
+    /** Type des valeurs d'une colonne */
+    enum Type {
+        INT32 = 0,
+        FLOAT64 = 1
+    };
+
+    /**
+     * @brief En-tête du fichier (64 octets)
+     */
+    struct Header {
+        char magic[8];          /**< "CELLTAB" */
+        uint32_t byteOrder;     /**< 0x01020304 dans l'ordre de l'écrivain */
+        uint32_t version;       /**< Version du format (1) */
+        uint64_t rows;          /**< Nombre de cellules */
+        uint32_t harmNb;        /**< Nombre d'harmoniques */
+        uint32_t columnNb;      /**< Nombre de colonnes */
+        uint32_t fourierLength; /**< Longueur des contours rééchantillonnés (0 si inconnue) */
+        uint32_t reserved[7];
+    };
+
+    /**
+     * @brief Entrée du répertoire des colonnes (32 octets)
+     */
+    struct Column {
+        char name[16];          /**< Nom, terminé par un zéro */
+        uint32_t type;          /**< @see Type */
+        uint32_t reserved;
+        uint64_t offset;        /**< Position des données depuis le début du fichier */
+    };
+
+
+    /**
+     * @brief Accumule les cellules, puis écrit le fichier colonne par colonne
+     */
+    class Writer {
+    public:
+        explicit Writer(int harmNb, int fourierLength = 0);
+
+        int rows() const;
+
+        /**
+         * @brief Ajoute une cellule (harmoniques manquantes à 0, en trop ignorées)
+         */
+        void append(int frame, int cell, const ShapeDescriptor::Cell& c);
+
+        void clear();
+
+        /**
+         * @return faux en cas d'erreur d'écriture
+         */
+        bool write(const QString& fileName) const;
+
+    private:
+        int _harmNb;
+        int _fourierLength;
+
+        std::vector<int32_t> _frame, _cell, _x, _y;
+        std::vector<double> _area, _variance, _peaks;
+        std::vector<std::vector<double> > _harm; /**< Une colonne par harmonique */
+    };
+
+
+    /**
+     * @brief Lecture d'un fichier par projection en mémoire.
+     *
+     * Les pointeurs retournés restent valides jusqu'à `close()` ou la
+     * destruction du lecteur.
+     */
+    class Reader {
+    public:
+        Reader();
+        ~Reader();
+
+        /**
+         * @return faux si le fichier ne peut pas être projeté ou n'est pas
+         * un fichier de ce format (ou d'une machine d'un autre boutisme)
+         */
+        bool open(const QString& fileName);
+        void close();
+        bool isOpen() const;
+
+        uint64_t rows() const;
+        int harmNb() const;
+        int fourierLength() const;
+
+        int columnNb() const;
+        const Column& column(int i) const;
+        int columnIndex(const char* name) const; /**< -1 si absente */
+
+        /**
+         * @brief Données de la colonne `name`, nul si elle est absente ou
+         * d'un autre type
+         */
+        const int32_t* int32Column(const char* name) const;
+        const double* float64Column(const char* name) const;
+
+        const int32_t* frames() const;
+        const int32_t* cells() const;
+        const int32_t* x() const;
+        const int32_t* y() const;
+        const double* area() const;
+        const double* variance() const;
+        const double* peaks() const;
+        const double* harmonic(int k) const; /**< Harmonique `k`, dans [0;harmNb) */
+
+    private:
+        const void* data(const char* name, Type type) const;
+
+        QFile _file;
+        const uchar* _map;
+        qint64 _size;
+        const Header* _header;
+        const Column* _columns;
+    };
+}
+
+#endif // CELLTABLE_H
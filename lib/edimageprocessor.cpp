@@ -1,3 +1,4 @@
+
 #include "edimageprocessor.h"
 
 EdImageProcessor::EdImageProcessor(QObject *parent) :
@@ -6,7 +7,9 @@ EdImageProcessor::EdImageProcessor(QObject *parent) :
     _threshLvl(0),
     _threshType(cv::THRESH_TOZERO ),
     _eltSize(0),
-    _evenImg(false){
+    _dirty(true),
+    _version(0),
+    _kernelScale(0.0){
 }
 
 EdImageProcessor::~EdImageProcessor(){}
@@ -17,20 +20,31 @@ EdImageProcessor::~EdImageProcessor(){}
  * **************************/
 
 void EdImageProcessor::setContrast(double lvl){
-    if (lvl >= 0)
+    if (lvl >= 0){
         _contrastLvl = lvl;
+        _dirty = true;
+        _version++;
+    }
 }
 
 void EdImageProcessor::setEltSize(int size){
     _eltSize = size;
+    _dirty = true;
+    _version++;
 }
 
 void EdImageProcessor::setThresh(int lvl){
     _threshLvl = lvl;
+    _dirty = true;
+    _version++;
 }
 
 void EdImageProcessor::setThreshType(int type){
-    _threshType = type;
+    // Le seuillage est une table de correspondance au seuil `_threshLvl` :
+    // les drapeaux de seuil automatique (THRESH_OTSU...) n'ont pas de sens
+    _threshType = type & cv::THRESH_MASK;
+    _dirty = true;
+    _version++;
 }
 
 
@@ -38,124 +52,151 @@ void EdImageProcessor::setThreshType(int type){
  *  Traitement
  * **************************/
 
-cv::Mat EdImageProcessor::process(cv::Mat src){
-    _evenImg = false;
+cv::Mat EdImageProcessor::process(cv::Mat src, double scale){
+    if (_dirty)  compile();
 
-    _img1 = src;
-    _img2 = cv::Mat::zeros(src.size(), src.type());
-
-    std::deque<PCode>::iterator it = _priority.begin();
-    while(it != _priority.end()){
-        switch (*it) {
-         case CTRST:
-            contrast();
-            break;
+    // Aucun traitement effectif : l'image est rendue telle quelle
+    if (_stages.empty())  return src;
 
-         case THRESH:
-            threshold();
-            break;
+    // Élément structurant réduit pour les niveaux réduits de l'image
+    const cv::Mat* kernel = &_kernel;
+    if (scale != 1.0 && _eltSize > 0){
+        if (scale != _kernelScale){
+            int size = eltSize(scale);
+            _scaledKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                                      cv::Size(size, size));
+            _kernelScale = scale;
+        }
+        kernel = &_scaledKernel;
+    }
 
-         case ERODE:
-            erode();
-            break;
+    const cv::Mat* in = &src;
+    cv::Mat* out = &_img1;
 
-         case DILATE:
-            dilate();
+    std::vector<Stage>::const_iterator it = _stages.begin();
+    while(it != _stages.end()){
+        if (it->point){
+            cv::LUT(*in, it->lut, *out);
         }
+        else if (it->code == ERODE){
+            cv::erode(*in, *out, *kernel);
+        }
+        else{
+            cv::dilate(*in, *out, *kernel);
+        }
+
+        in = out;
+        out = (out == &_img1) ? &_img2 : &_img1;
         it++;
     }
 
-    if (_evenImg) return _img2;
-    else return _img1;
+    return *in;
 }
 
 
-void EdImageProcessor::resetPriority(){
-    _priority.clear();
-}
+int EdImageProcessor::margin(double scale) const{
+    if (_eltSize <= 0)  return 0;
 
-void EdImageProcessor::addPriorList(PCode p){
-    _priority.push_back(p);
+    int n = 0;
+    for (size_t i=0; i<_priority.size(); i++)
+        if (_priority[i] == ERODE || _priority[i] == DILATE)  n++;
+    return n * (eltSize(scale) / 2);
 }
 
 
-/**************************
- * Méthodes de traitement
- * ************************/
-
-
-void edImageProcessor::chooseSourceImage(cv::Mat **src, cv::Mat **dest){
-    if (_evenImg){
-        *dst = &_img1;
-        *src = &_img2;
-    }
-    else{
-        *dst = &_img2;
-        *src = &_img1;
-    }
+int EdImageProcessor::eltSize(double scale) const{
+    int size = (int)(_eltSize * scale + 0.5);
+    return (size < 1) ? 1 : size;
 }
 
 
-void EdImageProcessor::contrast(){
-    cv::Mat *src = NULL;
-    cv::Mat *dst = NULL;
-
-    this->chooseSourceImage(&src, &dst);
-
-    // Contraste pour chaque point
-    for (int y=0; y<src->rows; y++){
-      for (int x=0; x<src->cols; x++){
-        for (int c=0; c<src->channels(); c++){
-          dst->at<cv::Vec3b>(y,x)[c] =
-           cv::saturate_cast<uchar>(_contrastLvl * (src->at<cv::Vec3b>(y,x)[c]));
-        }
-      }
-    }
-
-    _evenImg = !_evenImg;
+quint64 EdImageProcessor::version() const{
+    return _version;
 }
 
 
-void EdImageProcessor::threshold(){
-    cv::Mat *src = NULL;
-    cv::Mat *dst = NULL;
-
-    this->chooseSourceImage(&src, &dst);
-
-    cv::threshold(*src, *dst, _threshLvl, 255, _threshType);
-    _evenImg = !_evenImg;
+void EdImageProcessor::resetPriority(){
+    _priority.clear();
+    _dirty = true;
+    _version++;
 }
 
+void EdImageProcessor::addPriorList(PCode p){
+    _priority.push_back(p);
+    _dirty = true;
+    _version++;
+}
 
 
-void EdImageProcessor::erode(){
-    cv::Mat *src = NULL;
-    cv::Mat *dst = NULL;
-
-    this->chooseSourceImage(&src, &dst);
+/**************************
+ * Compilation de la chaine
+ * ************************/
 
-    cv::erode( *src,
-               *dst,
-               cv::getStructuringElement( cv.MORPH_ELLIPSE, (_eltSize, _eltSize))
-             );
+void EdImageProcessor::compile(){
+    cv::Mat identity(1, 256, CV_8U);
+    for (int i=0; i<256; i++)
+        identity.at<uchar>(i) = i;
 
-    _evenImg = !_evenImg;
-}
+    _stages.clear();
 
-void EdImageProcessor::dilate(){
-    cv::Mat *src = NULL;
-    cv::Mat *dst = NULL;
+    std::deque<PCode>::iterator it = _priority.begin();
+    while(it != _priority.end()){
+        switch (*it) {
+         case CTRST:
+         case THRESH:
+            // Fusion avec l'étape ponctuelle précédente
+            if (_stages.empty() || !_stages.back().point){
+                Stage s;
+                s.point = true;
+                s.code = *it;
+                identity.copyTo(s.lut);
+                _stages.push_back(s);
+            }
+            composeLut(_stages.back().lut, *it);
+            break;
 
-    this->chooseSourceImage(&src, &dst);
+         case ERODE:
+         case DILATE:
+            if (_eltSize > 0){
+                Stage s;
+                s.point = false;
+                s.code = *it;
+                _stages.push_back(s);
+            }
+        }
+        it++;
+    }
 
-    cv::dilate( *src,
-                *dst,
-                cv::getStructuringElement( cv.MORPH_ELLIPSE, (_eltSize, _eltSize))
-              );
+    // Les tables identité n'ont aucun effet
+    std::vector<Stage>::iterator s = _stages.begin();
+    while (s != _stages.end()){
+        if (s->point && cv::countNonZero(s->lut != identity) == 0)
+            s = _stages.erase(s);
+        else
+            s++;
+    }
 
-    _evenImg = !_evenImg;
+    _kernelScale = 0.0; // élément réduit à recalculer
+    if (_eltSize > 0)
+        _kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                            cv::Size(_eltSize, _eltSize));
+    _dirty = false;
 }
 
 
+void EdImageProcessor::composeLut(cv::Mat &lut, PCode p) const{
+    // Les traitements sont appliqués à la table elle-même : pour une image
+    // 8 bits, le résultat est identique à leur application sur l'image
+    switch (p) {
+     case CTRST:
+        lut.convertTo(lut, -1, _contrastLvl);
+        break;
 
+     case THRESH:
+        cv::threshold(lut, lut, _threshLvl, 255, _threshType);
+        break;
 
+     default:
+        break;
+    }
+}
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <opencv2/opencv.hpp>
 #include <deque>
+#include <vector>
 
 
 /**
@@ -16,6 +17,13 @@
  * en paramètre de process() pour obtenir le résultat de la
  * chaine de traitements.
  *
+ * La liste de priorité est compilée en une suite d'étapes : les
+ * traitements ponctuels consécutifs (contraste, seuillage) sont
+ * fusionnés en une seule table de correspondance appliquée en une
+ * passe, et seules les opérations de voisinage (morphologie) produisent
+ * une image intermédiaire. Les tampons sont réutilisés d'un appel à
+ * l'autre.
+ *
  * @author Évariste DALLER
  * @date Avril 2016
  */
@@ -53,8 +61,13 @@ public:
      * @brief Applique les traitements prévus dans l'ordre de la liste de
      * priorité, avec les paramètres précédemment réglés à l'aide des fonctions
      * adaptées.
-     * @param src  Image source
-     * @return Image après traitements
+     * @param src    Image source (8 bits)
+     * @param scale  échelle de `src` par rapport à l'image d'origine (niveau
+     *               réduit d'une pyramide) : la taille de l'élément
+     *               structurant est multipliée par `scale`
+     * @return Image après traitements. Elle partage les tampons internes
+     * (ou l'image source si aucun traitement ne la modifie) et n'est
+     * valide que jusqu'au prochain appel.
      *
      * @see setContrast
      * @see setThresh
@@ -62,7 +75,23 @@ public:
      * @see setThreshBin
      * @see addPriorList
      */
-    cv::Mat process(cv::Mat src);
+    cv::Mat process(cv::Mat src, double scale = 1.0);
+
+    /**
+     * @brief Nombre de pixels de voisinage lus par la chaine autour de
+     * chaque pixel (somme des rayons des opérations morphologiques).
+     * Traiter une partie de l'image agrandie de cette marge, puis la
+     * recadrer, donne le même résultat que traiter l'image entière.
+     * @param scale  @see process
+     */
+    int margin(double scale = 1.0) const;
+
+    /**
+     * @brief Version des paramètres, incrémentée à chaque modification de
+     * la configuration. Deux appels à process() sur la même image avec la
+     * même version donnent le même résultat.
+     */
+    quint64 version() const;
 
 
 public slots:
@@ -87,7 +116,9 @@ public slots:
     void setEltSize(int size);
 
     /**
-     * @brief Décide le type de seuillage
+     * @brief Décide le type de seuillage. Seul le type de base est gardé :
+     * les drapeaux de seuil automatique (THRESH_OTSU, THRESH_TRIANGLE)
+     * sont ignorés, le seuil est celui de `setThresh`.
      * @see cv::threshold()
      */
     void setThreshType(int type);
@@ -111,17 +142,29 @@ public slots:
 protected:
 
     /**
-     * @brief Helper function
-     *
-     * Choisi quelle est l'image source et la destination pour les
-     * traitements entre `this->_img1` et `this->_img2`
+     * @brief Étape de la chaine compilée
+     * @see compile
+     */
+    struct Stage {
+        bool point;     /**< Traitements ponctuels fusionnés (table `lut`) */
+        PCode code;     /**< ERODE ou DILATE si `point` est faux */
+        cv::Mat lut;    /**< Table des traitements ponctuels fusionnés */
+    };
+
+    /**
+     * @brief Compile la liste de priorité en étapes, en fusionnant les
+     * traitements ponctuels consécutifs. Appelée par process() lorsque
+     * la configuration a changé.
+     */
+    void compile();
+
+    /**
+     * @brief Applique à la table `lut` le traitement ponctuel `p`
      */
-    void edImageProcessor::chooseSourceImage(cv::Mat **src, cv::Mat **dest){
+    void composeLut(cv::Mat& lut, PCode p) const;
 
-    void contrast();
-    void threshold();
-    void erode();
-    void dilate();
+    /** Taille de l'élément structurant à l'échelle `scale` */
+    int eltSize(double scale) const;
 
     /* Membres */
 protected:
@@ -131,9 +174,14 @@ protected:
     int _threshType;
     int  _eltSize;
 
-    bool _evenImg;
+    bool _dirty;                /**< La chaine doit être recompilée */
+    quint64 _version;           /**< @see version */
+    std::vector<Stage> _stages; /**< Chaine compilée */
+    cv::Mat _kernel;            /**< Élément structurant */
+    cv::Mat _scaledKernel;      /**< Élément structurant à l'échelle `_kernelScale` */
+    double _kernelScale;
 
-    cv::Mat _img1;
+    cv::Mat _img1;              /**< Tampons des étapes, utilisés en alternance */
     cv::Mat _img2;
 };
 
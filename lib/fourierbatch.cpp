@@ -0,0 +1,153 @@
+
+#include <math.h>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include "lib/fourierbatch.h"
+
+
+/**
+ * @brief Paquet de lignes traité par un thread
+ */
+struct FourierBatch::_Chunk {
+    _Chunk(FourierBatch* b, const std::vector<std::vector<cv::Point> >* c,
+           int f, int l, cv::Mat* d) :
+        batch(b), contours(c), first(f), last(l), desc(d) {}
+
+    FourierBatch* batch;
+    const std::vector<std::vector<cv::Point> >* contours;
+    int first, last;
+    cv::Mat* desc;
+};
+
+void
+FourierBatch::describeChunk(_Chunk& c){
+    c.batch->describeRows(*(c.contours), c.first, c.last, *(c.desc));
+}
+
+
+FourierBatch::FourierBatch(int length, int harmNb) :
+    _length(4),
+    _harmNb(harmNb < 0 ? 0 : harmNb){
+    // Puissance de deux : cas le plus rapide de la FFT
+    while (_length < length)
+        _length <<= 1;
+    if (_harmNb > _length / 2)
+        _harmNb = _length / 2;
+}
+
+
+int
+FourierBatch::length() const{
+    return _length;
+}
+
+int
+FourierBatch::harmNb() const{
+    return _harmNb;
+}
+
+
+cv::Mat
+FourierBatch::describe(const std::vector<std::vector<cv::Point> >& contours){
+    int n = contours.size();
+    cv::Mat desc = cv::Mat::zeros(n, _harmNb, CV_64F);
+    if (n == 0 || _harmNb == 0)  return desc;
+
+    // Tampons réutilisés tant que le nombre de contours ne grandit pas
+    if (_signals.rows < n){
+        _signals.create(n, _length, CV_64F);
+        _spectrum.create(n, _length, CV_64F);
+    }
+
+    // Un paquet par thread, quelques-uns de plus pour équilibrer
+    int chunkNb = QThread::idealThreadCount() * 4;
+    if (chunkNb < 1)  chunkNb = 1;
+    int size = (n + chunkNb - 1) / chunkNb;
+    if (size < 16)  size = 16;
+
+    std::vector<_Chunk> chunks;
+    for (int first = 0; first < n; first += size)
+        chunks.push_back(_Chunk(this, &contours, first, std::min(n, first + size), &desc));
+
+    QtConcurrent::blockingMap(chunks, describeChunk);
+    return desc;
+}
+
+
+void
+FourierBatch::describeRows(const std::vector<std::vector<cv::Point> >& contours,
+                           int first, int last, cv::Mat& desc){
+    cv::Mat sig = _signals.rowRange(first, last);
+    cv::Mat spec = _spectrum.rowRange(first, last);
+
+    std::vector<bool> valid(last - first);
+    for (int i = first; i < last; i++)
+        valid[i - first] = tangentSignal(contours[i], _length, sig.ptr<double>(i - first));
+
+    // Toutes les lignes du paquet en un appel : sortie réelle compacte
+    // (Re0, Re1, Im1, Re2, Im2, ...)
+    cv::dft(sig, spec, cv::DFT_ROWS);
+
+    for (int i = first; i < last; i++){
+        if (!valid[i - first])  continue;
+
+        const double* s = spec.ptr<double>(i - first);
+        double* d = desc.ptr<double>(i);
+        for (int k = 1; k <= _harmNb; k++){
+            double re = s[2*k - 1];
+            double im = (2*k < _length) ? s[2*k] : 0.0; // Nyquist : réel
+            d[k - 1] = sqrt(re*re + im*im) / _length;
+        }
+    }
+}
+
+
+bool
+FourierBatch::tangentSignal(const std::vector<cv::Point>& contour, int n, double* diff){
+    int m = contour.size();
+    if (m < 3 || n < 2){
+        std::fill(diff, diff + n, 0.0);
+        return false;
+    }
+
+    // Abscisse curviligne cumulée (contour fermé)
+    std::vector<double> s(m + 1, 0.0);
+    for (int i = 0; i < m; i++){
+        const cv::Point& a = contour[i];
+        const cv::Point& b = contour[(i + 1) % m];
+        s[i + 1] = s[i] + sqrt(double((b.x - a.x)*(b.x - a.x) + (b.y - a.y)*(b.y - a.y)));
+    }
+    double perimeter = s[m];
+    if (perimeter <= 0){
+        std::fill(diff, diff + n, 0.0);
+        return false;
+    }
+
+    // Points régulièrement espacés (interpolation linéaire)
+    std::vector<cv::Point2d> p(n);
+    int j = 0;
+    for (int i = 0; i < n; i++){
+        double t = perimeter * i / n;
+        while (j < m - 1 && s[j + 1] <= t)  j++;
+        const cv::Point& a = contour[j];
+        const cv::Point& b = contour[(j + 1) % m];
+        double len = s[j + 1] - s[j];
+        double f = (len > 0) ? (t - s[j]) / len : 0.0;
+        p[i] = cv::Point2d(a.x + f * (b.x - a.x), a.y + f * (b.y - a.y));
+    }
+
+    // Orientation de la tangente, puis sa variation dans ]-PI;PI]
+    double prev = atan2(p[0].y - p[n-1].y, p[0].x - p[n-1].x);
+    for (int i = 0; i < n; i++){
+        const cv::Point2d& a = p[i];
+        const cv::Point2d& b = p[(i + 1) % n];
+        double an = atan2(b.y - a.y, b.x - a.x);
+        double d = an - prev;
+        while (d > M_PI)    d -= 2 * M_PI;
+        while (d <= -M_PI)  d += 2 * M_PI;
+        diff[i] = d;
+        prev = an;
+    }
+    return true;
+}
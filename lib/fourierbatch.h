@@ -0,0 +1,75 @@
+#ifndef FOURIERBATCH_H
+#define FOURIERBATCH_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * @brief Calcul des descripteurs de Fourier d'un grand nombre de contours
+ *
+ * Chaque contour est rééchantillonné à `length` points (une puissance de
+ * deux) régulièrement espacés le long du contour, puis la variation de
+ * l'orientation de la tangente est calculée en chaque point (ramenée dans
+ * ]-PI;PI]). Les signaux de tous les contours sont rangés dans une matrice
+ * (une ligne par contour) et transformés ligne à ligne par `cv::dft` :
+ * tous les contours ayant la même longueur, les tables de la FFT sont les
+ * mêmes pour toutes les lignes.
+ *
+ * Le descripteur d'un contour est le module des harmoniques 1 à `harmNb`,
+ * divisé par `length` : il ne dépend ni du point de départ, ni de
+ * l'orientation, ni de la taille du contour.
+ *
+ * Le travail est découpé en paquets de lignes traités en parallèle. Les
+ * matrices de travail sont conservées d'un appel à l'autre : une instance
+ * ne doit pas être utilisée par plusieurs threads à la fois.
+ *
+ * @see ShapeDescriptor::fourierDesc pour le descripteur d'une cellule isolée
+ */
+class FourierBatch {
+
+public:
+    /**
+     * @param length  nombre de points après rééchantillonnage (arrondi à la
+     *                puissance de deux supérieure)
+     * @param harmNb  nombre d'harmoniques conservées
+     */
+    explicit FourierBatch(int length = 256, int harmNb = 10);
+
+    int length() const;
+    int harmNb() const;
+
+    /**
+     * @brief Descripteurs de tous les contours
+     * @return matrice CV_64F de contours.size() lignes et harmNb colonnes
+     * (ligne nulle pour un contour de moins de 3 points)
+     */
+    cv::Mat describe(const std::vector<std::vector<cv::Point> >& contours);
+
+    /**
+     * @brief Rééchantillonne le contour fermé `contour` en `n` points
+     * régulièrement espacés, et écrit la variation de l'orientation de la
+     * tangente dans `diff` (n valeurs)
+     * @return faux si le contour est trop court
+     */
+    static bool tangentSignal(const std::vector<cv::Point>& contour, int n, double* diff);
+
+protected:
+    /**
+     * @brief Traite les lignes [first;last) de `_signals`
+     */
+    void describeRows(const std::vector<std::vector<cv::Point> >& contours,
+                      int first, int last, cv::Mat& desc);
+
+    struct _Chunk;
+    static void describeChunk(_Chunk& c); /**< Tâche de QtConcurrent */
+
+protected:
+    int _length;
+    int _harmNb;
+
+    cv::Mat _signals;   /**< Signaux, une ligne par contour (réutilisée) */
+    cv::Mat _spectrum;  /**< Transformées, une ligne par contour (réutilisée) */
+};
+
+#endif // FOURIERBATCH_H
@@ -1,78 +1,87 @@
+
+#include <math.h>
+#include <limits>
+
 #include "lib/qmathstools.h"
 
+
+/***************************
+ * Statistiques en une passe
+ ***************************/
+
+QMathsTools::Stats::Stats() :
+    _n(0), _mean(.0), _m2(.0),
+    _min(std::numeric_limits<double>::max()),
+    _max(-std::numeric_limits<double>::max()){
+}
+
+void
+QMathsTools::Stats::add(double x){
+    _n++;
+    double delta = x - _mean;
+    _mean += delta / _n;
+    _m2 += delta * (x - _mean);
+
+    if (x < _min)  _min = x;
+    if (x > _max)  _max = x;
+}
+
+int
+QMathsTools::Stats::count() const{
+    return _n;
+}
+
+double
+QMathsTools::Stats::mean() const{
+    return _mean;
+}
+
+double
+QMathsTools::Stats::variance() const{
+    return (_n > 0) ? _m2 / _n : .0;
+}
+
+double
+QMathsTools::Stats::min() const{
+    return _min;
+}
+
+double
+QMathsTools::Stats::max() const{
+    return _max;
+}
+
+
+/***************************
+ * Fonctions
+ ***************************/
+
 void
 QMathsTools::normalize(QVector<double>& vector, const double& value){
-    // Recherche du maximum
-    double max;
-    if (vector.size() > 0){
-        max = vector[0];
-    }
-    for (int i=1; i<vector.size(); i++){
-        max = (vector[i] > max) ? vector[i] : max;
-    }
-
-    // Normalisation
-    for (int i=0; i<vector.size(); i++){
-        vector[i] *= value / max;
-    }
+    normalize(vector.begin(), vector.end(), value);
 }
 
 
 double
 QMathsTools::median(const QVector<double>& a){
-    int n = a.size();
-    return kthSmallest(a, ((n & 1) ? (n / 2) : (n / 2)-1));
+    QVector<double> tmp(a);
+    return median(tmp.begin(), tmp.end());
 }
 
 
 double
 QMathsTools::kthSmallest(QVector<double> a, int k)
 {
-    int i,j,l,m;
-    double x;
-    double tmp;
-
-    l = 0;
-    m = a.size()-1;
-    while (l < m) {
-        x = a[k];
-        i = l;
-        j = m;
-        do {
-            while (i < a.size() && a[i] < x) i++;
-            while (j >= 0 && x < a[j]) j--;
-            if (i <= j){
-                tmp = a[i];
-                a[i] = a[j];  a[j] = tmp;
-                i++; j--;
-            }
-        } while (i <= j);
-        if (j < k) l=i;
-        if (k < i) m=j;
-    }
-    return a[k];
+    return kthSmallest(a.begin(), a.end(), k);
 }
 
 
 double
 QMathsTools::mean(const QVector<double>& samples){
-    double sum = .0;
-    for (int i=0; i<samples.size(); i++){
-        sum += samples[i];
-    }
-    return sum / samples.size();
+    return mean(samples.constBegin(), samples.constEnd());
 }
 
 double
 QMathsTools::variance(const QVector<double>& samples){
-    double m = mean(samples);
-    double sum = .0;
-    for (int i=0; i<samples.size(); i++){
-        sum += (m - samples[i]) * (m - samples[i]);
-    }
-    return sum / samples.size();
+    return variance(samples.constBegin(), samples.constEnd());
 }
-
-
-
-
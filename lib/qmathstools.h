@@ -2,13 +2,56 @@
 #define QMATHSTOOLS_H
 
 #include <QVector>
+#include <iterator>
+#include <algorithm>
 
 /**
  *  Regrouppement de fonctions utilitaires mathématiques
  *  utilisant les structures de données Qt (en particulier QVector)
+ *
+ *  Les versions génériques travaillent sur un intervalle [first;last)
+ *  d'itérateurs à accès aléatoire sur des valeurs arithmétiques
+ *  (float, double, entiers) : std::vector, QVector, ligne d'un cv::Mat
+ *  (`m.ptr<float>(r)`, `m.ptr<float>(r) + m.cols`) ou tampon brut, sans
+ *  conversion ni copie.
  */
 namespace QMathsTools{
 
+    /**
+     * @brief Statistiques d'un ensemble de valeurs, calculées en une seule
+     * passe : moyenne et variance (algorithme de Welford, stable
+     * numériquement), minimum et maximum.
+     *
+     * Les valeurs sont ajoutées une à une, sans être conservées.
+     */
+    class Stats {
+    public:
+        Stats();
+
+        void add(double x);     /**< Ajoute une valeur */
+
+        /** Ajoute les valeurs de [first;last) */
+        template<class It>
+        void add(It first, It last){
+            for (; first != last; ++first)
+                add(double(*first));
+        }
+
+        int count() const;
+        double mean() const;
+        double variance() const;  /**< Variance de la population (division par n) */
+        double min() const;
+        double max() const;
+
+    private:
+        int _n;
+        double _mean;
+        double _m2;     /**< Somme des carrés des écarts à la moyenne */
+        double _min;
+        double _max;
+    };
+
+
     /**
      * Normaliser un vecteur avec pour valeur maximale value.
      * T doit être un type arithmétique.
@@ -20,6 +63,7 @@ namespace QMathsTools{
 
     /**
      * Trouve la médiane de l'ensemble a avec la fonction kthSmallest.
+     * L'ensemble est copié : @see median(It, It) pour l'éviter.
      * @see kthSmallest
      */
     double median(const QVector<double>& a);
@@ -44,6 +88,102 @@ namespace QMathsTools{
     double kthSmallest(QVector<double> a, int k);
 
 
+    /**
+     * @brief k-ième plus petit élément de [first;last), par l'algorithme
+     * de sélection de Wirth, sans copie : les éléments sont réordonnés.
+     * @see kthSmallest(QVector<double>, int)
+     */
+    template<class It>
+    typename std::iterator_traits<It>::value_type
+    kthSmallest(It first, It last, int k){
+        typedef typename std::iterator_traits<It>::value_type T;
+        int n = last - first;
+        int i, j, l, m;
+        T x;
+
+        l = 0;
+        m = n-1;
+        while (l < m) {
+            x = first[k];
+            i = l;
+            j = m;
+            do {
+                while (i < n && first[i] < x) i++;
+                while (j >= 0 && x < first[j]) j--;
+                if (i <= j){
+                    std::swap(first[i], first[j]);
+                    i++; j--;
+                }
+            } while (i <= j);
+            if (j < k) l=i;
+            if (k < i) m=j;
+        }
+        return first[k];
+    }
+
+    /**
+     * @brief Quantile `q` (dans [0;1]) de [first;last), sans copie : les
+     * éléments sont réordonnés. Rang retenu : ceil(q*n)-1 (pour q = 0.5 et
+     * n pair, la médiane inférieure, comme median()).
+     */
+    template<class It>
+    typename std::iterator_traits<It>::value_type
+    quantile(It first, It last, double q){
+        int n = last - first;
+        int k = int(q * n);
+        k = (double(k) < q * n) ? k : k - 1;  // ceil(q*n) - 1
+        k = (k < 0) ? 0 : ((k >= n) ? n-1 : k);
+        return kthSmallest(first, last, k);
+    }
+
+    /**
+     * @brief Médiane de [first;last), sans copie (éléments réordonnés)
+     * @see median(const QVector<double>&)
+     */
+    template<class It>
+    typename std::iterator_traits<It>::value_type
+    median(It first, It last){
+        return quantile(first, last, 0.5);
+    }
+
+    /**
+     * @brief Moyenne de [first;last) (une passe)
+     */
+    template<class It>
+    double mean(It first, It last){
+        Stats s;
+        s.add(first, last);
+        return s.mean();
+    }
+
+    /**
+     * @brief Variance de [first;last) (une passe @see Stats)
+     */
+    template<class It>
+    double variance(It first, It last){
+        Stats s;
+        s.add(first, last);
+        return s.variance();
+    }
+
+    /**
+     * @brief Normalise [first;last) avec pour valeur maximale `value`
+     * (résultat tronqué pour les types entiers)
+     */
+    template<class It>
+    void normalize(It first, It last, double value = 1.0){
+        typedef typename std::iterator_traits<It>::value_type T;
+        if (first == last)  return;
+
+        double max = *std::max_element(first, last);
+        if (max == 0)  return;
+
+        double f = value / max;
+        for (; first != last; ++first)
+            *first = T(*first * f);
+    }
+
+
     /**
      * @brief Moyenne de l'ensemble
      * @param samples    tableau de valeurs
@@ -52,7 +192,7 @@ namespace QMathsTools{
     double mean(const QVector<double>& samples);
 
     /**
-     * @brief Variance de l'ensemble
+     * @brief Variance de l'ensemble (une seule passe @see Stats)
      * @param samples   tableau de valeurs
      * @return la variance
      */
@@ -60,8 +200,3 @@ namespace QMathsTools{
 }
 
 #endif // QMATHSTOOLS_H
-
-
-
-
-
@@ -0,0 +1,127 @@
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStringList>
+#include <QMutexLocker>
+
+#include "lib/resultjournal.h"
+
+
+ResultJournal::ResultJournal(){
+}
+
+ResultJournal::~ResultJournal(){
+    close();
+}
+
+
+bool
+ResultJournal::open(const QString& fileName){
+    QMutexLocker lock(&_mutex);
+
+    if (_file.isOpen())
+        _file.close();
+    _results.clear();
+    _file.setFileName(fileName);
+
+    // Relecture : une ligne incomplète (arrêt pendant l'écriture) est ignorée
+    qint64 complete = 0;    // Fin de la dernière ligne complète
+    bool truncated = false;
+    if (_file.open(QIODevice::ReadOnly)){
+        while (!_file.atEnd()){
+            QByteArray line = _file.readLine();
+            if (!line.endsWith('\n')){
+                truncated = true;
+                break;
+            }
+            complete = _file.pos();
+
+            QString l = QString::fromUtf8(line.constData(), line.size() - 1);
+            QStringList f = l.split(';');
+            if (f.size() < 4)  continue;
+
+            bool okH, okD, okR;
+            uint64_t params = f[0].toULongLong(&okH, 16);
+            qint64 mtime = f[1].toLongLong(&okD);
+            int result = f[2].toInt(&okR);
+            if (!okH || !okD || !okR)  continue;
+
+            QString path = QStringList(f.mid(3)).join(";");
+            _results.insert(key(path, mtime, params), result);
+        }
+        _file.close();
+    }
+
+    // La ligne incomplète est retirée : sinon le prochain résultat y
+    // serait collé, et perdu à la relecture suivante
+    if (truncated && !_file.resize(complete))  return false;
+
+    return _file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+
+void
+ResultJournal::close(){
+    QMutexLocker lock(&_mutex);
+    if (_file.isOpen())
+        _file.close();
+}
+
+
+bool
+ResultJournal::isOpen() const{
+    return _file.isOpen();
+}
+
+QString
+ResultJournal::fileName() const{
+    return _file.fileName();
+}
+
+int
+ResultJournal::size() const{
+    QMutexLocker lock(&_mutex);
+    return _results.size();
+}
+
+
+bool
+ResultJournal::find(const QString& path, uint64_t params, int& result) const{
+    QString k = key(path, modified(path), params);
+
+    QMutexLocker lock(&_mutex);
+    QHash<QString, int>::const_iterator it = _results.constFind(k);
+    if (it == _results.constEnd())  return false;
+    result = it.value();
+    return true;
+}
+
+
+bool
+ResultJournal::append(const QString& path, uint64_t params, int result){
+    qint64 mtime = modified(path);
+    QByteArray line = (QString::number((qulonglong)params, 16) + ";"
+                       + QString::number(mtime) + ";"
+                       + QString::number(result) + ";"
+                       + path + "\n").toUtf8();
+
+    QMutexLocker lock(&_mutex);
+    _results.insert(key(path, mtime, params), result);
+    if (!_file.isOpen())  return false;
+
+    // Une seule écriture par ligne, vidée aussitôt
+    bool ok = _file.write(line) == line.size();
+    return _file.flush() && ok;
+}
+
+
+qint64
+ResultJournal::modified(const QString& path){
+    return QFileInfo(path).lastModified().toMSecsSinceEpoch();
+}
+
+
+QString
+ResultJournal::key(const QString& path, qint64 mtime, uint64_t params){
+    return QString::number((qulonglong)params, 16) + ";" + QString::number(mtime) + ";" + path;
+}
@@ -0,0 +1,74 @@
+#ifndef RESULTJOURNAL_H
+#define RESULTJOURNAL_H
+
+#include <stdint.h>
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+
+/**
+ * @brief Journal des résultats d'un traitement par lot, pour reprendre
+ * un traitement interrompu.
+ *
+ * Le résultat de chaque image est ajouté au journal dès qu'il est
+ * calculé, une ligne par image, et écrit immédiatement sur le disque :
+ * un arrêt brutal ne perd au plus que la ligne en cours d'écriture
+ * (retirée du fichier à la réouverture).
+ *
+ * Un résultat est identifié par le chemin du fichier, sa date de
+ * modification et l'empreinte des paramètres du traitement : un fichier
+ * modifié, ou un traitement relancé avec d'autres paramètres, est
+ * recalculé.
+ *
+ * Format (texte, UTF-8) : `empreinte;date;résultat;chemin`, l'empreinte
+ * en hexadécimal, la date en millisecondes depuis l'époque Unix. Le
+ * chemin est en dernier : il peut contenir des `;`.
+ *
+ * `append` peut être appelé depuis plusieurs threads.
+ */
+class ResultJournal {
+
+public:
+    ResultJournal();
+    ~ResultJournal();
+
+    /**
+     * @brief Relit le journal `fileName` (s'il existe) et l'ouvre en ajout
+     * @return faux si le fichier ne peut pas être ouvert en écriture
+     */
+    bool open(const QString& fileName);
+    void close();
+    bool isOpen() const;
+
+    QString fileName() const;
+    int size() const;       /**< Nombre de résultats connus */
+
+    /**
+     * @brief Résultat déjà calculé pour le fichier `path` avec les
+     * paramètres d'empreinte `params`
+     * @return faux si le fichier n'a pas de résultat, ou a été modifié depuis
+     */
+    bool find(const QString& path, uint64_t params, int& result) const;
+
+    /**
+     * @brief Ajoute le résultat du fichier `path` (écrit immédiatement)
+     * @return faux en cas d'erreur d'écriture
+     */
+    bool append(const QString& path, uint64_t params, int result);
+
+    /** Date de modification de `path`, en ms depuis l'époque Unix */
+    static qint64 modified(const QString& path);
+
+protected:
+    /** Clé d'un résultat : empreinte, date, chemin */
+    static QString key(const QString& path, qint64 mtime, uint64_t params);
+
+protected:
+    QFile _file;
+    QHash<QString, int> _results;  /**< Résultats par clé */
+    mutable QMutex _mutex;
+};
+
+#endif // RESULTJOURNAL_H
@@ -0,0 +1,293 @@
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lib/qmathstools.h"
+#include "lib/shapedescriptor.h"
+
+
+/**
+ * @brief Sommes brutes de la région `mask` sur le rectangle `r`, en une
+ * passe : moments a[p][q] (p+q <= 3) relatifs au coin du rectangle,
+ * pondérés par l'intensité si `weighted`, et, si `c` est non nul, sommes
+ * pondérées par l'intensité d'ordre 0 et 1 (c[0], c[1] en x, c[2] en y)
+ */
+static void
+rawSums(const cv::Mat& gray, const cv::Mat& mask, const cv::Rect& r,
+        bool weighted, double a[4][4], double* c){
+    // Moments bruts relatifs au coin du rectangle : les coordonnées
+    // restent petites
+    for (int y=0; y<r.height; y++){
+        const uchar* mrow = mask.ptr<uchar>(r.y + y) + r.x;
+        const uchar* grow = (weighted || c) ? gray.ptr<uchar>(r.y + y) + r.x : 0;
+
+        int64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        int64_t g0 = 0, g1 = 0;
+        for (int x=0; x<r.width; x++){
+            if (mrow[x] == 0)  continue;
+            int64_t w = weighted ? 255 - grow[x] : 1;
+            int64_t wx = w * x;
+            s0 += w;
+            s1 += wx;
+            s2 += wx * x;
+            s3 += wx * x * x;
+            if (c){
+                int64_t g = 255 - grow[x];
+                g0 += g;
+                g1 += g * x;
+            }
+        }
+        if (c){
+            c[0] += g0;
+            c[1] += g1;
+            c[2] += double(g0) * y;
+        }
+        if (s0 == 0)  continue;
+
+        double y1 = y, y2 = y1 * y, y3 = y2 * y;
+        a[0][0] += s0;       a[1][0] += s1;       a[2][0] += s2;  a[3][0] += s3;
+        a[0][1] += s0 * y1;  a[1][1] += s1 * y1;  a[2][1] += s2 * y1;
+        a[0][2] += s0 * y2;  a[1][2] += s1 * y2;
+        a[0][3] += s0 * y3;
+    }
+}
+
+
+/**
+ * @brief Moments centrés, normalisés, bruts dans le repère de l'image et
+ * invariants de Hu, à partir des sommes brutes `a` du rectangle `r`
+ * @see rawSums
+ */
+static ShapeDescriptor::Moments
+fromRawSums(const double a[4][4], const cv::Rect& r){
+    ShapeDescriptor::Moments mo;
+    memset(&mo, 0, sizeof(mo));
+
+    double m00 = a[0][0];
+    if (m00 == 0)  return mo;
+
+    // Centre de gravité (relatif), puis moments centrés
+    double xc = a[1][0] / m00;
+    double yc = a[0][1] / m00;
+    mo.center = cv::Point2d(r.x + xc, r.y + yc);
+
+    mo.mu[0][0] = m00;
+    mo.mu[2][0] = a[2][0] - xc * a[1][0];
+    mo.mu[1][1] = a[1][1] - xc * a[0][1];
+    mo.mu[0][2] = a[0][2] - yc * a[0][1];
+    mo.mu[3][0] = a[3][0] - 3 * xc * a[2][0] + 2 * xc * xc * a[1][0];
+    mo.mu[2][1] = a[2][1] - 2 * xc * a[1][1] - yc * a[2][0] + 2 * xc * xc * a[0][1];
+    mo.mu[1][2] = a[1][2] - 2 * yc * a[1][1] - xc * a[0][2] + 2 * yc * yc * a[1][0];
+    mo.mu[0][3] = a[0][3] - 3 * yc * a[0][2] + 2 * yc * yc * a[0][1];
+
+    // Moments bruts dans le repère de l'image (translation du repère)
+    static const int C[4][4] = {{1,0,0,0}, {1,1,0,0}, {1,2,1,0}, {1,3,3,1}};
+    for (int p=0; p<4; p++)
+        for (int q=0; p+q<4; q++)
+            for (int i=0; i<=p; i++)
+                for (int j=0; j<=q; j++)
+                    mo.m[p][q] += C[p][i] * C[q][j]
+                                * pow(double(r.x), p-i) * pow(double(r.y), q-j)
+                                * a[i][j];
+
+    // Moments normalisés et invariants de Hu
+    for (int p=0; p<4; p++)
+        for (int q=0; p+q<4; q++)
+            if (p+q >= 2)
+                mo.nu[p][q] = mo.mu[p][q] / pow(m00, 1.0 + (p+q) / 2.0);
+
+    double n20 = mo.nu[2][0], n02 = mo.nu[0][2], n11 = mo.nu[1][1];
+    double n30 = mo.nu[3][0], n03 = mo.nu[0][3], n21 = mo.nu[2][1], n12 = mo.nu[1][2];
+    double t0 = n30 + n12, t1 = n21 + n03;
+    double q0 = t0 * t0, q1 = t1 * t1;
+    double d0 = n30 - 3 * n12, d1 = 3 * n21 - n03;
+
+    mo.hu[0] = n20 + n02;
+    mo.hu[1] = (n20 - n02) * (n20 - n02) + 4 * n11 * n11;
+    mo.hu[2] = d0 * d0 + d1 * d1;
+    mo.hu[3] = q0 + q1;
+    mo.hu[4] = d0 * t0 * (q0 - 3 * q1) + d1 * t1 * (3 * q0 - q1);
+    mo.hu[5] = (n20 - n02) * (q0 - q1) + 4 * n11 * t0 * t1;
+    mo.hu[6] = d1 * t0 * (q0 - 3 * q1) - d0 * t1 * (3 * q0 - q1);
+
+    return mo;
+}
+
+
+/** Rectangle de calcul : `box` dans l'image, toute l'image si `box` est vide */
+static cv::Rect
+clipBox(const cv::Mat& mask, const cv::Rect& box){
+    cv::Rect r = cv::Rect(0, 0, mask.cols, mask.rows);
+    if (box.area() > 0)
+        r &= box;
+    return r;
+}
+
+
+ShapeDescriptor::Moments
+ShapeDescriptor::moments(const cv::Mat& gray, const cv::Mat& mask,
+                         const cv::Rect& box, bool weighted){
+    cv::Rect r = clipBox(mask, box);
+    double a[4][4] = {{0}};
+    rawSums(gray, mask, r, weighted, a, 0);
+    return fromRawSums(a, r);
+}
+
+
+ShapeDescriptor::Moments
+ShapeDescriptor::moments(const cv::Mat& gray, const cv::Mat& mask,
+                         const cv::Rect& box, cv::Point2i& centroid){
+    cv::Rect r = clipBox(mask, box);
+    double a[4][4] = {{0}};
+    double c[3] = {0, 0, 0};
+    rawSums(gray, mask, r, false, a, c);
+
+    centroid = (c[0] > 0) ? cv::Point2i((int)(r.x + c[1] / c[0]), (int)(r.y + c[2] / c[0]))
+                          : cv::Point2i(0, 0);
+    return fromRawSums(a, r);
+}
+
+
+cv::Point2i
+ShapeDescriptor::centroid(const cv::Mat& gray, const cv::Mat& mask, const cv::Rect& box){
+    Moments mo = moments(gray, mask, box, true);
+    return cv::Point2i((int)(mo.center.x), (int)(mo.center.y));
+}
+
+
+void
+ShapeDescriptor::centerContour(const std::vector<cv::Point>& contour, const cv::Point2i& g,
+                               QVector<double>& x, QVector<double>& y){
+    x.resize(contour.size()+1);
+    y.resize(contour.size()+1);
+    for (int i=0; i<contour.size(); i++){
+        x[i] = contour[i].x - g.x;
+        y[i] = - contour[i].y + g.y;
+    }
+    x[x.size()-1] = x[0];
+    y[y.size()-1] = y[0];
+}
+
+
+void
+ShapeDescriptor::polarSignature(const QVector<double>& x, const QVector<double>& y,
+                                QVector<double>& a, QVector<double>& m){
+    // Le dernier point (fermeture de la courbe) n'est pas pris en compte
+    int n = x.size() - 1;
+    m.resize(n); // magnitude
+    a.resize(n); // angle
+
+    // Le maximum est relevé au passage : pas de passe supplémentaire
+    double max = .0;
+    for (int i=0; i<n; i++){
+        a[i] = atan2(y[i], x[i]);
+        m[i] = sqrt((x[i]*x[i]) + (y[i]*y[i]));
+        if (m[i] > max)  max = m[i];
+    }
+
+    // On normalise la magnitude
+    if (max > 0)
+        for (int i=0; i<n; i++)  m[i] /= max;
+}
+
+
+std::vector<double>
+ShapeDescriptor::polarDesc(const QVector<double>& m){
+    std::vector<double> desc(3);
+
+    // Première dimension : la variance (une passe)
+    QMathsTools::Stats stats;
+    stats.add(m.constBegin(), m.constEnd());
+    desc[0] = stats.variance();
+
+    // Deuxième dimension : le nombre de groupes au dessus de la médiane.
+    // La sélection réordonne les valeurs : elle travaille sur une copie,
+    // l'ordre de `m` sert au comptage des groupes
+    std::vector<double> tmp(m.constBegin(), m.constEnd());
+    double med = tmp.empty() ? .0 : QMathsTools::median(tmp.begin(), tmp.end());
+    int n = 0; bool in = false;
+    for (int i=0; i<m.size(); i++){
+        if (!in && m[i] > med){
+            n++; // on a trouvé un pic
+            in = true;
+        }
+        if (in && m[i] <= med){
+            in = false; // On sors du pic
+        }
+    }
+    // On traite la périodicité : que ce passe-t-il pour le dernier point ?
+    //  -> On supprime un groupe compté double si le premier et le dernier point sont dans un pic
+    if (in && m[0] > med) n--;
+    desc[1] = n;
+
+    // Troisième dimension : nombre moyen de points du contour pour un angle donné
+    //...
+    desc[2] = 1.0;
+
+    return desc;
+}
+
+
+bool
+ShapeDescriptor::tangentVariation(const QVector<double>& x, const QVector<double>& y, int step,
+                                  QVector<double>& e, QVector<double>& d, QVector<double>& diff){
+    if (x.size() <= step)  return false;
+
+    int size = x.size() / step;
+    e.fill(.0, size);
+    d.fill(.0, size);
+    diff.fill(.0, size);
+
+    double an = .0;
+    double anprev = atan2(y[step]-y[0], x[step]-x[0]);
+    for (int i=0; i<size-1; i++){
+        e[i] = double(i) * ((2*M_PI) / size); // <- normalisation dans [0;2PI]
+        an = atan2(y[i*step + step]-y[i*step],
+                   x[i*step + step]-x[i*step]); // angle
+        d[i] = an;
+        diff[i] = an - anprev;
+        anprev = an;
+    }
+    return true;
+}
+
+
+std::vector<double>
+ShapeDescriptor::fourierDesc(const QVector<double>& diff, int harmNb){
+    int nh = (diff.size() > harmNb) ? harmNb : diff.size();
+
+    // Le tampon de `diff` est utilisé directement, sans conversion
+    cv::Mat src(1, diff.size(), CV_64F, const_cast<double*>(diff.constData()));
+    cv::Mat dst;
+    cv::dft(src, dst, cv::DFT_REAL_OUTPUT);
+
+    const double* p = dst.ptr<double>(0);
+    return std::vector<double>(p, p + nh);
+}
+
+
+ShapeDescriptor::Cell
+ShapeDescriptor::describe(const cv::Mat& gray, const cv::Mat& mask,
+                          const std::vector<cv::Point>& contour, int step, int harmNb){
+    Cell c;
+    c.contour = contour;
+
+    // Une seule passe sur le rectangle englobant : centre de gravité
+    // pondéré et moments de la forme
+    cv::Rect box = cv::boundingRect(contour);
+    Moments shape = moments(gray, mask, box, c.centroid);
+    c.area = shape.m[0][0];
+    c.hu.assign(shape.hu, shape.hu + 7);
+
+    QVector<double> x, y, a, m;
+    centerContour(contour, c.centroid, x, y);
+    polarSignature(x, y, a, m);
+    c.polar = polarDesc(m);
+
+    QVector<double> e, d, diff;
+    if (harmNb > 0 && tangentVariation(x, y, step, e, d, diff))
+        c.fourier = fourierDesc(diff, harmNb);
+
+    return c;
+}
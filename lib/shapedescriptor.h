@@ -0,0 +1,139 @@
+#ifndef SHAPEDESCRIPTOR_H
+#define SHAPEDESCRIPTOR_H
+
+#include <vector>
+#include <QVector>
+#include <opencv2/opencv.hpp>
+
+/**
+ *  Calcul des descripteurs de forme basés contours, indépendamment
+ *  de tout affichage :
+ *  * signature polaire
+ *  * descripteurs de Fourier (variation de la tangente au contour)
+ *  * moments de la région (bruts, centrés, invariants de Hu)
+ *
+ *  Les fonctions n'ont pas d'état et peuvent être appelées depuis
+ *  plusieurs threads.
+ */
+namespace ShapeDescriptor{
+
+    /**
+     * @brief Descripteurs d'une cellule
+     */
+    struct Cell {
+        cv::Point2i seed;                 /**< Germe de la croissance de région */
+        cv::Point2i centroid;             /**< Centre de gravité (pondéré) */
+        std::vector<cv::Point> contour;   /**< Contour de la cellule */
+        std::vector<double> polar;        /**< Descripteur de signature polaire */
+        std::vector<double> fourier;      /**< Descripteur de Fourier */
+        double area;                      /**< Aire (pixels) */
+        std::vector<double> hu;           /**< Invariants de Hu de la forme */
+
+        Cell() : area(0) {}
+    };
+
+
+    /**
+     * @brief Moments d'une région jusqu'à l'ordre 3 (indices [p][q],
+     * p+q <= 3 ; les autres cases sont nulles)
+     */
+    struct Moments {
+        double m[4][4];     /**< Moments bruts, dans le repère de l'image */
+        double mu[4][4];    /**< Moments centrés */
+        double nu[4][4];    /**< Moments centrés normalisés */
+        double hu[7];       /**< Invariants de Hu */
+        cv::Point2d center; /**< Centre de gravité */
+    };
+
+    /**
+     * @brief Moments de la région `mask` en une passe, limitée au
+     * rectangle englobant `box` (toute l'image si `box` est vide).
+     *
+     * Les sommes de chaque ligne sont exactes (entiers 64 bits), puis
+     * cumulées en double.
+     *
+     * @param gray      image en niveaux de gris (ignorée si `weighted` est faux)
+     * @param mask      masque (non nul dans la région)
+     * @param box       rectangle englobant la région
+     * @param weighted  pondération par l'intensité (255 - gris : les
+     *                  pixels sombres pèsent plus), sinon pixels de poids 1
+     */
+    Moments moments(const cv::Mat& gray, const cv::Mat& mask,
+                    const cv::Rect& box = cv::Rect(), bool weighted = false);
+
+    /**
+     * @brief Moments non pondérés de la région et centre de gravité
+     * pondéré par l'intensité (@see centroid), en une seule passe sur le
+     * rectangle englobant `box`
+     * @param centroid  [out] centre de gravité pondéré
+     */
+    Moments moments(const cv::Mat& gray, const cv::Mat& mask,
+                    const cv::Rect& box, cv::Point2i& centroid);
+
+
+    /**
+     * @brief Centre de gravité de la région, pondéré par l'intensité
+     * (les pixels sombres pèsent plus)
+     * @param gray  image en niveaux de gris
+     * @param mask  masque (non nul dans la région)
+     * @param box   rectangle englobant la région (toute l'image si vide)
+     * @see moments
+     */
+    cv::Point2i centroid(const cv::Mat& gray, const cv::Mat& mask,
+                         const cv::Rect& box = cv::Rect());
+
+    /**
+     * @brief Contour exprimé dans un repère centré en `g` (axe y vers le
+     * haut). Le premier point est répété à la fin pour fermer la courbe.
+     */
+    void centerContour(const std::vector<cv::Point>& contour, const cv::Point2i& g,
+                       QVector<double>& x, QVector<double>& y);
+
+    /**
+     * @brief Signature polaire du contour centré (x,y) : angle et
+     * magnitude normalisée (max = 1) de chaque point
+     */
+    void polarSignature(const QVector<double>& x, const QVector<double>& y,
+                        QVector<double>& a, QVector<double>& m);
+
+    /**
+     * Descripteur basé sur la signature polaire.
+     * Descripteur à trois dimensions :
+     * * variance de la signature
+     * * nombre de groupes de points au dessus de la médiane (nombre de "pics")
+     * * nombre moyen de points par angle dans la signature
+     */
+    std::vector<double> polarDesc(const QVector<double>& m);
+
+    /**
+     * @brief Orientation de la tangente au contour centré (x,y), et sa
+     * variation, avec un pas de `step` points
+     * @param e     [out] abscisse normalisée dans [0;2PI]
+     * @param d     [out] angle de la tangente
+     * @param diff  [out] variation de l'angle de la tangente
+     * @return faux si le contour est trop court
+     */
+    bool tangentVariation(const QVector<double>& x, const QVector<double>& y, int step,
+                          QVector<double>& e, QVector<double>& d, QVector<double>& diff);
+
+    /**
+     * @brief Les `harmNb` premiers coefficients de la transformée de
+     * Fourier de la variation de la tangente, tels que rangés par
+     * `cv::dft` (réels, non normalisés). Différent du descripteur de
+     * FourierBatch (modules normalisés des harmoniques 1 à N).
+     */
+    std::vector<double> fourierDesc(const QVector<double>& diff, int harmNb);
+
+    /**
+     * @brief Calcule tous les descripteurs de la région
+     * @param gray     image en niveaux de gris
+     * @param mask     masque rempli de la région
+     * @param contour  contour de la région
+     * @param step     pas pour la tangente @see tangentVariation
+     * @param harmNb   nombre d'harmoniques (0 : pas de descripteur de Fourier)
+     */
+    Cell describe(const cv::Mat& gray, const cv::Mat& mask,
+                  const std::vector<cv::Point>& contour, int step, int harmNb);
+}
+
+#endif // SHAPEDESCRIPTOR_H
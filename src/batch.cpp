@@ -0,0 +1,205 @@
+/******************************************
+ * batch.cpp
+ * ****************************************
+ *
+ * Comptage de cellules en ligne de commande,
+ * sans interface graphique.
+ *
+ * Usage :
+ *   CellsBatch [options] <fichiers ou répertoires>
+ *
+ * Options :
+ *   -c <contraste>   coefficient de contraste (défaut 1.0)
+ *   -l <luminosité>  décalage de luminosité (défaut 0)
+ *   -t <seuil>       active le seuillage au niveau donné
+ *   -a <méthode>     active le seuillage, seuil calculé pour chaque image :
+ *                    otsu, multiotsu ou triangle
+ *   -n               seuillage non inversé
+ *   -s <forme>       forme de l'élément structurant (0 ellipse, 1 rect, 2 croix)
+ *   -e <taille>      ajoute une érosion
+ *   -d <taille>      ajoute une dilatation
+ *   -j <threads>     nombre de threads de traitement
+ *   -r <journal>     journal des résultats : chaque résultat y est ajouté
+ *                    dès qu'il est calculé, et les images déjà comptées
+ *                    avec les mêmes paramètres ne sont pas recomptées
+ *
+ * Le résultat est écrit sur la sortie standard, une ligne
+ * `fichier;nombre` par image, dans l'ordre des fichiers.
+ */
+
+#include <iostream>
+#include <chrono>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFileInfo>
+#include <QDir>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QtConcurrentMap>
+
+#include "lib/cellcounter.h"
+#include "lib/resultjournal.h"
+
+
+/**
+ * @brief Foncteur de traitement d'un fichier (lecture + comptage)
+ */
+struct CountFile {
+    typedef int result_type;
+
+    CountFile(const CellCounter& c, ResultJournal* j, QAtomicInt* r) :
+        counter(c), hash(c.params().hash()), journal(j), resumed(r) {}
+
+    int operator()(const QString& fileName) const {
+        int n;
+        if (journal && journal->find(fileName, hash, n)){
+            resumed->fetchAndAddRelaxed(1);
+            return n;
+        }
+
+        n = counter.countFile(fileName.toStdString());
+        if (journal && n >= 0)  journal->append(fileName, hash, n);
+        return n;
+    }
+
+    const CellCounter& counter;
+    uint64_t hash;
+    ResultJournal* journal;   /**< Nul si pas de journal */
+    QAtomicInt* resumed;      /**< Images reprises du journal */
+};
+
+
+static void usage(){
+    std::cerr << "Usage : CellsBatch [-c contraste] [-l luminosite] [-t seuil | -a methode] [-n]"
+              << " [-s forme] [-e taille] [-d taille] [-j threads] [-r journal]"
+              << " <fichiers ou repertoires>" << std::endl;
+}
+
+
+static QStringList listImages(const QString& path){
+    QStringList res;
+    QFileInfo info(path);
+
+    if (info.isDir()){
+        QStringList filters;
+        filters << "*.jpg" << "*.jpeg" << "*.png" << "*.tiff" << "*.tif" << "*.bmp"
+                << "*.JPG" << "*.JPEG" << "*.PNG";
+
+        QDir dir(path);
+        dir.setNameFilters(filters);
+        QStringList files = dir.entryList(QDir::Files | QDir::Readable, QDir::Name);
+        for (int i=0; i<files.length(); i++)
+            res << dir.filePath(files[i]);
+    }
+    else if (info.isFile()){
+        res << path;
+    }
+    return res;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    CellCounter::Params params;
+    int shape = cv::MORPH_ELLIPSE;
+    QStringList files;
+    QString journalName;
+
+    for (int i=1; i<args.size(); i++){
+        const QString& arg = args[i];
+        bool hasValue = (i+1 < args.size());
+
+        if (arg == "-n"){
+            params.invThresh = false;
+        }
+        else if (arg.startsWith("-") && arg.size() == 2 && !hasValue){
+            usage();
+            return 1;
+        }
+        else if (arg == "-c"){
+            params.contrast = args[++i].toDouble();
+        }
+        else if (arg == "-l"){
+            params.lumin = args[++i].toInt();
+        }
+        else if (arg == "-t"){
+            params.threshEn = true;
+            params.thresh = args[++i].toInt();
+        }
+        else if (arg == "-a"){
+            QString m = args[++i];
+            params.threshEn = true;
+            if      (m == "otsu")       params.threshMode = CellCounter::OTSU;
+            else if (m == "multiotsu")  params.threshMode = CellCounter::MULTI_OTSU;
+            else if (m == "triangle")   params.threshMode = CellCounter::TRIANGLE;
+            else{
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "-s"){
+            switch (args[++i].toInt()){
+            case 1:  shape = cv::MORPH_RECT;    break;
+            case 2:  shape = cv::MORPH_CROSS;   break;
+            default: shape = cv::MORPH_ELLIPSE;
+            }
+        }
+        else if (arg == "-e"){
+            params.morpho.push_back(
+                CellCounter::Morpho(CellCounter::ERODE, args[++i].toInt(), shape));
+        }
+        else if (arg == "-d"){
+            params.morpho.push_back(
+                CellCounter::Morpho(CellCounter::DILATE, args[++i].toInt(), shape));
+        }
+        else if (arg == "-j"){
+            QThreadPool::globalInstance()->setMaxThreadCount(args[++i].toInt());
+        }
+        else if (arg == "-r"){
+            journalName = args[++i];
+        }
+        else{
+            files << listImages(arg);
+        }
+    }
+
+    if (files.isEmpty()){
+        usage();
+        return 1;
+    }
+
+    CellCounter counter(params);
+
+    ResultJournal journal;
+    if (!journalName.isEmpty() && !journal.open(journalName)){
+        std::cerr << "[E] Impossible d'écrire le journal : "
+                  << journalName.toStdString() << std::endl;
+        return 1;
+    }
+    QAtomicInt resumed(0);
+
+    auto start = std::chrono::steady_clock::now();
+    QList<int> counts = QtConcurrent::blockingMapped<QList<int> >(
+                files, CountFile(counter, journal.isOpen() ? &journal : 0, &resumed));
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> diff = end - start;
+
+    for (int i=0; i<files.size(); i++){
+        if (counts[i] < 0)
+            std::cerr << "[E] Impossible de lire le fichier : "
+                      << files[i].toStdString() << std::endl;
+        else
+            std::cout << files[i].toStdString() << ";" << counts[i] << std::endl;
+    }
+
+    std::cerr << files.size() << " images en " << diff.count() << " s ("
+              << files.size() / diff.count() << " images/s)" << std::endl;
+    if (resumed.load() > 0)
+        std::cerr << resumed.load() << " images reprises du journal" << std::endl;
+
+    return 0;
+}
@@ -19,10 +19,18 @@ Component::setEnabled(bool e){
 }
 
 
-QDomDocument*
-Component::getXml(){
-    updateXml();
-    return &_data;
+bool
+Component::saveXml(QIODevice* device){
+    QXmlStreamWriter xml(device);
+    xml.setAutoFormatting(true);
+    xml.setAutoFormattingIndent(2);
+
+    // Même forme que QDomDocument::save : DOCTYPE, sans déclaration XML
+    xml.writeDTD("<!DOCTYPE " + xmlDocType() + ">");
+    writeXml(xml);
+    xml.writeEndDocument();
+
+    return !xml.hasError();
 }
 
 
@@ -4,9 +4,18 @@
 #include <QCheckBox>
 #include <QSpinBox>
 #include <QPushButton>
+#include <QListWidget>
+#include <QLabel>
+#include <QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QtDebug>
 
 #include <math.h>
 #include <stack>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <cstdlib>
 
 #include "lib/qmathstools.h"
 #include "include/contours.h"
@@ -15,9 +24,12 @@
 Contours::Contours(MainWindow* w, QWidget* ui, ViewerCVGl *v, Player *p) :
     Component(w,ui),
     _viewer(v), _player(p),
+    _fourierBatch(256, 10),
+    _similarSel(-1),
     _seed(cv::Point2i(0,0)),
-    _thresh(0), _editSeed(false), _seedPlaced(false),
-    _homPred(HomoPredicateType::MEAN), _harmNb(10),
+    _thresh(0), _levelValid(false), _editSeed(false), _seedPlaced(false),
+    _homPred(HomoPredicateType::MEAN), _growAlgo(GrowAlgo::LEVELS),
+    _harmNb(10),
     _init(false)
 {
     initPlots();
@@ -46,14 +58,15 @@ Contours::copyOrigImage(){
     _editSeed = false;
     _seedPlaced = false;
 
-    _viewer->originImage().copyTo(_originColor);
-    if (_originColor.channels() == 3 || _originColor.channels() == 4)
-        cv::cvtColor(_originColor, _origin, cv::COLOR_RGB2GRAY);
-    else
-        _originColor.copyTo(_origin);
-
-    _originColor.copyTo(_rendered);
+    // Pas de copie : les pixels ne sont dupliqués que pour dessiner dessus
+    _originColor = _viewer->originFrame();
+    _origin = _originColor.gray();
+    _rendered = _originColor;
     _mask.create(_origin.size(), CV_8UC1);
+
+    _cells.clear();
+    _labels.release();
+    _levelValid = false;
     render();
 }
 
@@ -62,7 +75,7 @@ Contours::disable(){
     QObject::disconnect(_player, SIGNAL(fileListIdChanged(int)),
                      this, SLOT(copyOrigImage())
                     );
-    _viewer->showImage(_originColor);
+    _viewer->showFrame(_originColor);
 
     _editSeed = false; // au cas où
     _seedPlaced = false;
@@ -78,11 +91,12 @@ Contours::editSeed(){
 void
 Contours::placeSeed(int x, int y){
     if (_editSeed){
-        x = (x > _rendered.cols) ? _rendered.cols : x;
-        y = (y > _rendered.rows) ? _rendered.rows : y;
+        x = (x >= _rendered.width()) ? _rendered.width() - 1 : x;
+        y = (y >= _rendered.height()) ? _rendered.height() - 1 : y;
         _seed.x = (x < 0) ? 0 : x;
         _seed.y = (y < 0) ? 0 : y;
         _seedPlaced = true;
+        _levelValid = false;
         render();
     }
     _editSeed = false;
@@ -117,14 +131,43 @@ Contours::displayContours(bool d){
 
 void
 Contours::setHarmNb(int n){
-    if (n > 0) _harmNb = n;
+    if (n > 0){
+        _harmNb = n;
+        _fourierBatch = FourierBatch(_fourierBatch.length(), n);
+
+        // Les descripteurs n'ont plus la même dimension
+        _index.clear();
+        _frameCells.clear();
+    }
     render();
 }
 
+void
+Contours::setGrowAlgo(int a){
+    switch(a){
+    case 0:
+        _growAlgo = GrowAlgo::SCANLINE;
+        break;
+    case 1:
+        _growAlgo = GrowAlgo::STACK;
+        break;
+    case 2:
+        _growAlgo = GrowAlgo::LEVELS;
+        break;
+    }
+    if (_seedPlaced)   render();
+}
+
+void
+Contours::setAutoSeedParams(const CellCounter::Params& p){
+    _autoSeedParams = p;
+}
+
 void
 Contours::render(){
     regGrow();
-    _viewer->showImage(_rendered);
+    drawSimilar();
+    _viewer->showFrame(_rendered);
 }
 
 
@@ -135,43 +178,68 @@ Contours::render(){
 void
 Contours::regGrow(){
     if (_seedPlaced){
-        cv::Mat tmp;
         cv::Mat mask;
-        //cv::cvtColor(_origin, tmp, cv::COLOR_RGB2GRAY);
-
-        uchar val = _origin.at<uchar>(_seed);
+#ifdef CELLS_TIMING
+        QElapsedTimer timer;
+        timer.start();
+#endif
 
         switch(_homPred){
         case HomoPredicateType::MEAN:
-            segmReg(_origin, mask, _MeanPredicate(_thresh), _seed);
+            grow(_origin, mask, _MeanPredicate(_thresh));
             break;
         case HomoPredicateType::VAL:
-            segmReg(_origin, mask, _ValuePredicate((int)(val), _thresh), _seed);
+            // Algorithme choisi explicitement : pour comparer les résultats
+            if (_growAlgo != GrowAlgo::LEVELS){
+                grow(_origin, mask, _ValuePredicate((int)(_origin.at<uchar>(_seed)), _thresh));
+                break;
+            }
+
+            // Même résultat que grow(_origin, mask, _ValuePredicate(val, _thresh)),
+            // sans refaire la croissance à chaque changement de seuil
+            if (!_levelValid){
+                _levelGrow.reset(_origin, _seed);
+                _levelValid = true;
+            }
+            _levelGrow.region(_thresh, mask);
         }
+#ifdef CELLS_TIMING
+        qint64 growNs = timer.nsecsElapsed();
+#endif
 
         // Sélection de l'image à afficher : l'originale ou le masque (binaire)
         if (_displayContours){
-            _originColor.copyTo(_rendered);
+            _rendered = _originColor;
         }else{
-            mask.copyTo(_rendered);
+            _rendered = Frame(mask);
         }
 
+        // La région est d'un seul tenant : un seul contour extérieur.
+        // findContours modifie son entrée : le masque affiché n'y est pas
+        // passé directement
+        cv::Mat scratch = _displayContours ? mask : mask.clone();
         cv::vector<cv::vector<cv::Point> > ct;
-        cv::findContours(mask, ct, cv::RETR_TREE, cv::CHAIN_APPROX_NONE);
+        cv::findContours(scratch, ct, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
         if (ct.size() > 0){
             _contour = ct[0];
 
-            cv::drawContours(_rendered, ct, 0, cv::Scalar(0,0,255), 1);
-            _mask = cv::Mat::zeros(mask.size(), CV_8UC1);
-            cv::drawContours(_mask, ct, 0, 255, 1);
+            cv::drawContours(_rendered.edit(), ct, 0, cv::Scalar(0,0,255), 1);
 
-            _mask.copyTo(tmp);
-            segmReg(tmp, _mask, _ValuePredicate(0,1), _seed);
+            // Masque plein (trous compris) : remplissage du polygone, plutôt
+            // qu'une seconde croissance de région depuis le germe
+            _mask = cv::Mat::zeros(mask.size(), CV_8UC1);
+            cv::drawContours(_mask, ct, 0, 255, -1); // épaisseur < 0 : remplissage
+#ifdef CELLS_TIMING
+            // L'ancien remplissage refaisait la croissance : il coûtait
+            // environ le temps de croissance de plus que ce remplissage
+            qDebug("Croissance : %.2f ms, contour et remplissage : %.2f ms",
+                   growNs / 1e6, (timer.nsecsElapsed() - growNs) / 1e6);
+#endif
             drawShapePlots();
         }
     }
     else{
-        _origin.copyTo(_rendered);
+        _rendered = Frame(_origin);
     }
 }
 
@@ -212,77 +280,229 @@ void Contours::segmReg(const cv::Mat& ims, cv::Mat& imd,
 }
 
 
-void
-Contours::updateXml(){
-    _data = QDomDocument("Contours");
+/**
+ * @brief Carte des visites à 1 bit par pixel
+ */
+class _VisitMap {
+public:
+    _VisitMap(int rows, int cols) :
+        _stride((cols + 63) / 64),
+        _bits(size_t(rows) * _stride, 0)
+    {}
 
-    QDomElement root = _data.createElement("descripteurs");
-    _data.appendChild(root);
+    bool test(int x, int y) const {
+        return (_bits[size_t(y) * _stride + (x >> 6)] >> (x & 63)) & 1;
+    }
 
-    QDomElement signNode = _data.createElement("signature");
-    QDomElement fourierNode = _data.createElement("fourier");
-    QDomElement node;
-    QDomText value;
+    void set(int x, int y){
+        _bits[size_t(y) * _stride + (x >> 6)] |= uint64_t(1) << (x & 63);
+    }
 
-    node = _data.createElement("variance");
-    value = _data.createTextNode(QString::number(_polarDesc[0]));
-    node.appendChild(value);
-    signNode.appendChild(node);
+private:
+    size_t _stride;               /**< Nombre de mots par ligne */
+    std::vector<uint64_t> _bits;
+};
 
-    node = _data.createElement("pics");
-    value = _data.createTextNode(QString::number(_polarDesc[1]));
-    node.appendChild(value);
-    signNode.appendChild(node);
 
-    for (int i=0; i<_fourierDesc.size(); i++){
-        node = _data.createElement("harm");
-        node.setAttribute("n", i);
-        value = _data.createTextNode(QString::number(_fourierDesc[i]));
-        node.appendChild(value);
-        fourierNode.appendChild(node);
+/**
+ * @brief Segment `[x1;x2]` de pixels acceptés sur la ligne `y`
+ */
+struct _Span {
+    _Span(int y_, int x1_, int x2_) : y(y_), x1(x1_), x2(x2_) {}
+    int y, x1, x2;
+};
+
+
+template<class BinaryPredicate>
+void Contours::segmRegScanline(const cv::Mat& ims, cv::Mat& imd,
+                               BinaryPredicate hmg, const cv::Point& seed){
+
+    // On n'accepte que des matrice de type uchar
+    CV_Assert(ims.depth() == CV_8U);
+
+    // Même domaine que segmReg : la première ligne et la première colonne
+    // ne sont pas explorées
+    const int xmin = 1, ymin = 1;
+    const int xmax = ims.cols - 1, ymax = ims.rows - 1;
+
+    _VisitMap visit(ims.rows, ims.cols);
+    std::vector<_Span> spans;
+    spans.reserve(2 * ims.rows);
+
+    /* initialisation */
+    imd = cv::Mat::zeros(ims.size(), CV_8UC1);
+
+    // Étend à gauche et à droite le pixel accepté (x,y) et retourne le
+    // segment obtenu
+    auto fillRow = [&](int x, int y) -> _Span {
+        uchar* row = imd.ptr<uchar>(y);
+        int l = x, r = x;
+        while (l-1 >= xmin && !visit.test(l-1, y) && hmg(ims, cv::Point2i(l-1, y))){
+            l--;
+            visit.set(l, y);
+        }
+        while (r+1 <= xmax && !visit.test(r+1, y) && hmg(ims, cv::Point2i(r+1, y))){
+            r++;
+            visit.set(r, y);
+        }
+        std::fill(row + l, row + r + 1, uchar(255)); // Label = 1 (255)
+        return _Span(y, l, r);
+    };
+
+    visit.set(seed.x, seed.y);
+    if (seed.x >= xmin && seed.y >= ymin){
+        spans.push_back(fillRow(seed.x, seed.y));
+    }
+    else{
+        // Germe sur la première ligne ou colonne : comme dans segmReg, il
+        // est accepté seul et seuls ses voisins du domaine sont explorés
+        imd.at<uchar>(seed) = 255;
+        for (int i=0; i<4; i++){
+            cv::Point2i q = v4(seed, i);
+            if (q.x < xmin || q.x > xmax || q.y < ymin || q.y > ymax)  continue;
+            if (!visit.test(q.x, q.y) && hmg(ims, q)){
+                visit.set(q.x, q.y);
+                spans.push_back(fillRow(q.x, q.y));
+            }
+        }
     }
 
-    root.appendChild(signNode);
-    root.appendChild(fourierNode);
+    while (!spans.empty()){
+        _Span s = spans.back();
+        spans.pop_back();
+
+        /* Lignes voisines (au dessus et en dessous) */
+        for (int ny = s.y - 1; ny <= s.y + 1; ny += 2){
+            if (ny < ymin || ny > ymax)  continue;
+
+            for (int x = s.x1; x <= s.x2; x++){
+                if (x < xmin || x > xmax)  continue;
+                if (!visit.test(x, ny) && hmg(ims, cv::Point2i(x, ny))){
+                    visit.set(x, ny);
+                    _Span n = fillRow(x, ny);
+                    spans.push_back(n);
+                    x = n.x2; // le reste du segment est déjà traité
+                }
+            }
+        }
+    }
+}
+
+
+template<class BinaryPredicate>
+void Contours::grow(const cv::Mat& ims, cv::Mat& imd, BinaryPredicate hmg){
+    switch(_growAlgo){
+    case GrowAlgo::SCANLINE:
+    case GrowAlgo::LEVELS: // pas de carte des niveaux pour ce prédicat
+        segmRegScanline(ims, imd, hmg, _seed);
+        break;
+    case GrowAlgo::STACK:
+        segmReg(ims, imd, hmg, _seed);
+    }
+}
+
+
+QString
+Contours::xmlDocType() const{
+    return "Contours";
 }
 
 
 void
-Contours::drawShapePlots(){
-    // Trouver le centre de gravité
-    cv::Point2i p;
-    uint sumX, sumY, coefs; // < pour le calcul de la moyenne
-
-    sumX = 0;
-    sumY = 0;
-    coefs = 0;
-    for (p.y=0; p.y<_origin.rows; (p.y)++){
-        for (p.x=0; p.x<_origin.cols; (p.x)++){
-            if (_mask.at<uchar>(p) != 0){
-                sumX += (255 - (int)(_origin.at<uchar>(p))) * p.x;
-                sumY += (255 - (int)(_origin.at<uchar>(p))) * p.y;
-                coefs += 255 - (int)(_origin.at<uchar>(p));
+Contours::writeXml(QXmlStreamWriter& xml){
+    xml.writeStartElement("descripteurs");
+
+    xml.writeStartElement("signature");
+    if (_polarDesc.size() > 1){ // pas de cellule sélectionnée sinon
+        xml.writeTextElement("variance", QString::number(_polarDesc[0]));
+        xml.writeTextElement("pics", QString::number(_polarDesc[1]));
+    }
+    xml.writeEndElement();
+
+    xml.writeStartElement("fourier");
+    for (int i=0; i<_fourierDesc.size(); i++){
+        xml.writeStartElement("harm");
+        xml.writeAttribute("n", QString::number(i));
+        xml.writeCharacters(QString::number(_fourierDesc[i]));
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+
+    if (_polarDesc.size() > 1)
+        writeMoments(xml, _moments.m[0][0], _moments.hu, _moments.hu + 7);
+
+    // Cellules segmentées automatiquement
+    if (!_cells.empty()){
+        xml.writeStartElement("cellules");
+
+        for (int i=0; i<_cells.size(); i++){
+            xml.writeStartElement("cellule");
+            xml.writeAttribute("id", QString::number(i+1));
+            xml.writeAttribute("x", QString::number(_cells[i].centroid.x));
+            xml.writeAttribute("y", QString::number(_cells[i].centroid.y));
+
+            xml.writeStartElement("signature");
+            xml.writeTextElement("variance", QString::number(_cells[i].polar[0]));
+            xml.writeTextElement("pics", QString::number(_cells[i].polar[1]));
+            xml.writeEndElement();
+
+            // Pas le même descripteur que <fourier> : module des
+            // harmoniques 1 à N du contour rééchantillonné @see FourierBatch
+            xml.writeStartElement("harmoniques");
+            xml.writeAttribute("longueur", QString::number(_fourierBatch.length()));
+            for (int j=0; j<_cells[i].fourier.size(); j++){
+                xml.writeStartElement("module");
+                xml.writeAttribute("n", QString::number(j+1));
+                xml.writeCharacters(QString::number(_cells[i].fourier[j]));
+                xml.writeEndElement();
             }
+            xml.writeEndElement();
+
+            if (!_cells[i].hu.empty())
+                writeMoments(xml, _cells[i].area, &_cells[i].hu[0],
+                             &_cells[i].hu[0] + _cells[i].hu.size());
+            xml.writeEndElement(); // cellule
         }
+        xml.writeEndElement(); // cellules
+    }
+
+    xml.writeEndElement(); // descripteurs
+}
+
+
+void
+Contours::writeMoments(QXmlStreamWriter& xml, double area, const double* hu, const double* huEnd){
+    xml.writeStartElement("moments");
+    xml.writeAttribute("aire", QString::number(area, 'g', 16)); // comme QDomElement::setAttribute
+
+    for (int i=0; hu+i != huEnd; i++){
+        xml.writeStartElement("hu");
+        xml.writeAttribute("n", QString::number(i+1));
+        xml.writeCharacters(QString::number(hu[i]));
+        xml.writeEndElement();
     }
+    xml.writeEndElement();
+}
+
 
-    p.x = (coefs == 0) ? 0 : sumX / coefs;
-    p.y = (coefs == 0) ? 0 : sumY / coefs;
-    cv::circle(_rendered, p, 2, cv::Scalar(255,0,0),-1); // Affichage de G
+void
+Contours::drawShapePlots(){
+    // Trouver le centre de gravité, et les moments de la forme, en une
+    // passe sur le rectangle englobant seulement
+    cv::Rect box = cv::boundingRect(_contour);
+    cv::Point2i p;
+    _moments = ShapeDescriptor::moments(_origin, _mask, box, p);
+    cv::circle(_rendered.edit(), p, 2, cv::Scalar(255,0,0),-1); // Affichage de G
 
     // Convertir les contours (et translater pour centrer en G)
-    QVector<double> x(_contour.size()+1);
-    QVector<double> y(_contour.size()+1);
+    QVector<double> x, y;
+    ShapeDescriptor::centerContour(_contour, p, x, y);
     double xmax = .0;
     double ymax = .0;
-    for (int i=0; i<_contour.size(); i++){
-        x[i] = _contour[i].x - p.x;
-        y[i] = - _contour[i].y + p.y;
+    for (int i=0; i<x.size(); i++){
         if (x[i] > xmax) xmax = x[i];
         if (y[i] > ymax) ymax = y[i];
     }
-    x[x.size()-1] = x[0];
-    y[y.size()-1] = y[0];
     double margin = 3.0;
     double max = (xmax > ymax) ? xmax : ymax;
     max += margin;
@@ -295,13 +515,9 @@ Contours::drawShapePlots(){
 
 
     // Calcul de la signature polaire = contour exprimé en coordonnées polaires
-    QVector<double> m(_contour.size()); // magnitude
-    QVector<double> a(_contour.size()); // angle
-    for (uint i=0; i<_contour.size(); i++){
-        a[i] = atan2(y[i], x[i]);
-        m[i] = sqrt((x[i]*x[i]) + (y[i]*y[i]));
-    }
-    QMathsTools::normalize(m, 1.0); // On normalise la magnitude
+    QVector<double> m; // magnitude
+    QVector<double> a; // angle
+    ShapeDescriptor::polarSignature(x, y, a, m);
 
     _flatCurve->setData(a,m);
     _flat->rescaleAxes();
@@ -309,37 +525,19 @@ Contours::drawShapePlots(){
     _flat->replot();
 
     // Mise à jour des descripteurs
-    updatePolarDesc(a,m);
+    _polarDesc = ShapeDescriptor::polarDesc(m);
 
 
     // Calcul du différentiel d'angle de tangente pour fourier
-    if (x.size() > D_FOURIER){
-        int size = x.size() / D_FOURIER;
-        QVector<double> d(size);
-        QVector<double> e(size);
-        QVector<double> diff(size);
-        double an = .0;
-        double anprev = atan2(y[D_FOURIER]-y[0], x[D_FOURIER]-x[0]);
-        for (uint i=0; i<size-1; i++){
-            e[i] = double(i) * ((2*M_PI) / size); // <- normalisation dans [0;2PI]
-            an = atan2(y[i*D_FOURIER + D_FOURIER]-y[i*D_FOURIER],
-                       x[i*D_FOURIER + D_FOURIER]-x[i*D_FOURIER]); // angle
-            d[i] = an;
-            diff[i] = an - anprev;
-            anprev = an;
-        }
-
+    QVector<double> d, e, diff;
+    if (ShapeDescriptor::tangentVariation(x, y, D_FOURIER, e, d, diff)){
         _varCurve->setData(e, d);
         _var->rescaleAxes();
         _var->replot();
 
 
         // Fourier
-        int nh = (diff.size() > _harmNb) ? _harmNb : diff.size();
-
-        _fourierDesc.clear();
-        cv::dft(diff.toStdVector(), _fourierDesc, cv::DFT_REAL_OUTPUT);
-        _fourierDesc.resize(nh);
+        _fourierDesc = ShapeDescriptor::fourierDesc(diff, _harmNb);
 
         _fourierCurve->clearData();
         double min = .0;
@@ -357,37 +555,269 @@ Contours::drawShapePlots(){
 }
 
 
-void
-Contours::updatePolarDesc(const QVector<double>& a, const QVector<double>& m){
-    _polarDesc.clear();
-    _polarDesc.resize(3);
-
-    // Première dimension : la variance
-    _polarDesc[0] = QMathsTools::variance(m);
-
-    // Deuxième dimension : le nombre de groupes au dessus de la médiane
-    double med = QMathsTools::median(m);
-    int n = 0; bool in = false;
-    for (int i=0; i<m.size(); i++){
-        if (!in && m[i] > med){
-            n++; // on a trouvé un pic
-            in = true;
+/****************** Segmentation automatique *****************/
+
+struct Contours::_GrowCell {
+    typedef ShapeDescriptor::Cell result_type;
+
+    /** Demi-côté de la première fenêtre de croissance autour du germe */
+    static const int WINDOW = 32;
+
+    _GrowCell(const cv::Mat& g, HomoPredicateType h, int t) :
+        gray(g), homPred(h), thresh(t) {}
+
+    ShapeDescriptor::Cell operator()(const cv::Point2i& seed) const {
+        const cv::Rect image(0, 0, gray.cols, gray.rows);
+
+        // La croissance est faite dans une fenêtre autour du germe, doublée
+        // tant que la région touche un bord de la fenêtre intérieur à
+        // l'image : les tampons (masque, visites, remplissage) ont la
+        // taille de la cellule, pas celle de l'image
+        cv::Rect roi;
+        cv::Mat mask;
+        for (int r = WINDOW; ; r *= 2){
+            roi = cv::Rect(seed.x - r, seed.y - r, 2*r + 1, 2*r + 1) & image;
+            grow(gray(roi), mask, seed - roi.tl());
+            if (roi == image || !touchesBorder(mask, roi, image))  break;
         }
-        if (in && m[i] <= med){
-            in = false; // On sors du pic
+
+        std::vector<std::vector<cv::Point> > ct;
+        cv::findContours(mask, ct, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
+        if (ct.empty())  return ShapeDescriptor::Cell();
+
+        // La région est la plus grande composante trouvée
+        int best = 0;
+        for (int i=1; i<ct.size(); i++)
+            if (ct[i].size() > ct[best].size())  best = i;
+
+        cv::Mat filled = cv::Mat::zeros(roi.size(), CV_8UC1);
+        cv::drawContours(filled, ct, best, 255, -1); // épaisseur < 0 : remplissage
+
+        // Pas d'harmoniques ici : elles sont calculées en lot, après
+        // l'élimination des doublons @see FourierBatch
+        ShapeDescriptor::Cell c = ShapeDescriptor::describe(gray(roi), filled, ct[best],
+                                                            D_FOURIER, 0);
+
+        // Coordonnées de la fenêtre vers celles de l'image
+        for (int i=0; i<c.contour.size(); i++)
+            c.contour[i] += roi.tl();
+        c.centroid += roi.tl();
+        c.seed = seed;
+        return c;
+    }
+
+    void grow(const cv::Mat& ims, cv::Mat& imd, const cv::Point2i& seed) const {
+        switch(homPred){
+        case HomoPredicateType::MEAN:
+            segmRegScanline(ims, imd, _MeanPredicate(thresh), seed);
+            break;
+        case HomoPredicateType::VAL:
+            segmRegScanline(ims, imd, _ValuePredicate((int)(ims.at<uchar>(seed)), thresh), seed);
         }
     }
-    // On traite la périodicité : que ce passe-t-il pour le dernier point ?
-    //  -> On supprime un groupe compté double si le premier et le dernier point sont dans un pic
-    if (in && m[0] > med) n--;
-    _polarDesc[1] = n;
 
-    // Troisième dimension : nombre moyen de points du contour pour un angle donné
-    //...
-    _polarDesc[2] = 1.0;
+    /**
+     * @brief La région `mask` de la fenêtre `roi` a-t-elle pu être
+     * arrêtée par un bord de la fenêtre qui n'est pas un bord de l'image ?
+     * La première ligne et la première colonne de la fenêtre ne sont pas
+     * explorées (@see segmRegScanline) : la région s'arrête à la deuxième.
+     */
+    static bool touchesBorder(const cv::Mat& mask, const cv::Rect& roi, const cv::Rect& image){
+        return (roi.x > 0 && cv::countNonZero(mask.col(1)) > 0)
+            || (roi.y > 0 && cv::countNonZero(mask.row(1)) > 0)
+            || (roi.br().x < image.br().x && cv::countNonZero(mask.col(mask.cols - 1)) > 0)
+            || (roi.br().y < image.br().y && cv::countNonZero(mask.row(mask.rows - 1)) > 0);
+    }
+
+    const cv::Mat& gray;
+    HomoPredicateType homPred;
+    int thresh;
+};
+
+
+void
+Contours::segmentAll(){
+    _editSeed = false;
+    _seedPlaced = false;
+
+    // Un germe par forme détectée par la chaine de comptage. Contours
+    // extérieurs seulement : le centre d'un trou est un point du fond
+    std::vector<std::vector<cv::Point> > ct;
+    CellCounter::findCells(CellCounter(_autoSeedParams).process(_originColor.mat()),
+                           ct, cv::RETR_EXTERNAL);
+
+    std::vector<cv::Point2i> seeds;
+    for (int i=0; i<ct.size(); i++){
+        // Le centre de la forme s'il lui appartient, un point du contour sinon
+        cv::Moments mo = cv::moments(ct[i]);
+        cv::Point2i g = ct[i][0];
+        if (mo.m00 > 0){
+            cv::Point2f c(mo.m10 / mo.m00, mo.m01 / mo.m00);
+            if (cv::pointPolygonTest(ct[i], c, false) > 0)
+                g = cv::Point2i(c.x, c.y);
+        }
+        seeds.push_back(g);
+    }
+
+    std::vector<ShapeDescriptor::Cell> cells =
+        QtConcurrent::blockingMapped<std::vector<ShapeDescriptor::Cell> >(
+            seeds, _GrowCell(_origin, _homPred, _thresh));
+
+    // Image des labels ; deux germes dans la même région ne donnent
+    // qu'une cellule
+    _cells.clear();
+    _labels = cv::Mat::zeros(_origin.size(), CV_32SC1);
+    for (int i=0; i<cells.size(); i++){
+        if (cells[i].contour.empty())  continue;
+        if (_labels.at<int>(cells[i].seed) != 0)  continue;
+
+        _cells.push_back(cells[i]);
+        std::vector<std::vector<cv::Point> > c(1, cells[i].contour);
+        cv::drawContours(_labels, c, 0, cv::Scalar(_cells.size()), -1);
+    }
+
+    // Descripteurs de Fourier de toutes les cellules en un lot
+    std::vector<std::vector<cv::Point> > contours(_cells.size());
+    for (int i=0; i<_cells.size(); i++)
+        contours[i] = _cells[i].contour;
+    cv::Mat fourier = _fourierBatch.describe(contours);
+    for (int i=0; i<_cells.size(); i++)
+        _cells[i].fourier.assign(fourier.ptr<double>(i), fourier.ptr<double>(i) + fourier.cols);
+
+    // Les cellules de l'image remplacent celles d'une segmentation précédente
+    int frame = _player->shownId();
+    std::vector<ShapeDescriptor::Cell>& kept = _frameCells[frame];
+    kept = _cells;
+    for (int i=0; i<kept.size(); i++)
+        std::vector<cv::Point>().swap(kept[i].contour); // inutile au fichier
+    _index.removeFrame(frame);
+    for (int i=0; i<_cells.size(); i++)
+        _index.add(frame, _cells[i].centroid,
+                   indexVector(_cells[i].polar, _cells[i].fourier, _cells[i].hu));
+    // Les groupes de la recherche approchée sont recalculés ici, pas à
+    // la recherche
+    _index.trainIfNeeded();
+
+    _ui->findChild<QLabel*>("conInfoLabel")->setText(
+                QString("%1 cellules segmentées (%2 dans l'index)")
+                .arg(_cells.size()).arg(_index.size()));
+    renderCells();
+}
+
+
+bool
+Contours::saveCells(const QString& fileName) const{
+    CellTable::Writer writer(_fourierBatch.harmNb(), _fourierBatch.length());
+    QMap<int, std::vector<ShapeDescriptor::Cell> >::const_iterator it;
+    for (it = _frameCells.constBegin(); it != _frameCells.constEnd(); ++it){
+        const std::vector<ShapeDescriptor::Cell>& cells = it.value();
+        for (int i=0; i<cells.size(); i++)
+            writer.append(it.key(), i+1, cells[i]);
+    }
+    return writer.write(fileName);
+}
+
+
+void
+Contours::findSimilar(){
+    if (!_seedPlaced || _contour.empty() || _polarDesc.empty())  return;
+
+    // Même calcul des harmoniques que pour les cellules de l'index
+    std::vector<std::vector<cv::Point> > ct(1, _contour);
+    cv::Mat fourier = _fourierBatch.describe(ct);
+    std::vector<double> hu(_moments.hu, _moments.hu + 7);
+    std::vector<double> q = indexVector(_polarDesc,
+                                        std::vector<double>(fourier.ptr<double>(0),
+                                                            fourier.ptr<double>(0) + fourier.cols),
+                                        hu);
+
+    QElapsedTimer timer;
+    timer.start();
+    _similar = _index.search(q, 10);
+    _similarSel = -1;
+    qint64 ms = timer.elapsed();
+
+    // Résultats : liste (double-clic pour aller à la cellule) et résumé
+    QListWidget* list = _ui->findChild<QListWidget*>("conSimilarList");
+    list->clear();
+    for (int i=0; i<_similar.size(); i++)
+        list->addItem(QString("Image %1 (%2, %3) - distance %4")
+                      .arg(_similar[i].frame + 1)
+                      .arg(_similar[i].pos.x).arg(_similar[i].pos.y)
+                      .arg(_similar[i].dist, 0, 'f', 3));
+
+    _ui->findChild<QLabel*>("conInfoLabel")->setText(
+                QString("%1 cellules similaires parmi %2 en %3 ms%4")
+                .arg(_similar.size()).arg(_index.size()).arg(ms)
+                .arg(_index.approximate() ? " (recherche approchée)" : ""));
+
+    drawSimilar();
+    _viewer->showFrame(_rendered);
 }
 
+
+void
+Contours::showSimilar(QListWidgetItem* item){
+    int i = item->listWidget()->row(item);
+    if (i < 0 || i >= _similar.size())  return;
+    _similarSel = i;
+
+    // L'image de la cellule est dessinée à son affichage (@see render)
+    if (_similar[i].frame != _player->shownId())
+        _player->showFrame(_similar[i].frame);
+    else
+        render();
+
+    _viewer->centerOn(_similar[i].pos.x, _similar[i].pos.y);
+}
+
+
+void
+Contours::drawSimilar(){
+    int frame = _player->shownId();
+    cv::Mat* img = 0;
+    for (int i=0; i<_similar.size(); i++){
+        if (_similar[i].frame != frame)  continue;
+        if (!img)  img = &_rendered.edit();
+
+        if (i == _similarSel)
+            cv::circle(*img, _similar[i].pos, 8, cv::Scalar(0,255,255), 2);
+        else
+            cv::circle(*img, _similar[i].pos, 6, cv::Scalar(0,255,0), 1);
+    }
+}
+
+
+void
+Contours::renderCells(){
+    _rendered = _originColor;
+    cv::Mat& img = _rendered.edit();
+
+    for (int i=0; i<_cells.size(); i++){
+        std::vector<std::vector<cv::Point> > c(1, _cells[i].contour);
+        cv::drawContours(img, c, 0, cv::Scalar(0,0,255), 1);
+        cv::circle(img, _cells[i].centroid, 2, cv::Scalar(255,0,0), -1);
+    }
+    _viewer->showFrame(_rendered);
+}
+
+
 /****************** Utils *****************/
+std::vector<double>
+Contours::indexVector(const std::vector<double>& polar, const std::vector<double>& fourier,
+                      const std::vector<double>& hu){
+    std::vector<double> v;
+    v.insert(v.end(), polar.begin(), polar.begin() + std::min<size_t>(2, polar.size()));
+    v.insert(v.end(), fourier.begin(), fourier.end());
+
+    // Les invariants de Hu décroissent très vite avec leur ordre
+    for (int i=0; i<hu.size(); i++){
+        double h = hu[i];
+        v.push_back((h == 0) ? 0 : ((h > 0) ? -1 : 1) * log10(fabs(h)));
+    }
+    return v;
+}
+
 cv::Point2i
 Contours::v4(cv::Point2i p, int n){
     cv::Point2i r;
@@ -482,6 +912,19 @@ Contours::init(){
 
     QObject::connect(_ui->findChild<QSpinBox*>("conHarmoniques"),
                      SIGNAL(valueChanged(int)), this, SLOT(setHarmNb(int)));
+
+    QObject::connect(_ui->findChild<QComboBox*>("conGrowAlgo"),
+                     SIGNAL(activated(int)), this, SLOT(setGrowAlgo(int)));
+
+    QObject::connect(_ui->findChild<QPushButton*>("conAutoSeg"),
+                     SIGNAL(pressed()), this, SLOT(segmentAll()));
+
+    QObject::connect(_ui->findChild<QPushButton*>("conSimilar"),
+                     SIGNAL(pressed()), this, SLOT(findSimilar()));
+
+    QObject::connect(_ui->findChild<QListWidget*>("conSimilarList"),
+                     SIGNAL(itemActivated(QListWidgetItem*)),
+                     this, SLOT(showSimilar(QListWidgetItem*)));
 }
 
 void
@@ -608,3 +1051,69 @@ _ValuePredicate::operator()(const cv::Mat& ims, const cv::Point2i& p){
 }
 
 
+_LevelGrow::_LevelGrow() :
+    _val(0),
+    _done(0)
+{}
+
+void
+_LevelGrow::reset(const cv::Mat& ims, const cv::Point2i& seed){
+    // On n'accepte que des matrice de type uchar
+    CV_Assert(ims.type() == CV_8UC1);
+
+    _ims = ims;
+    _seed = seed;
+    _val = ims.at<uchar>(seed);
+
+    _level.create(ims.size(), CV_16UC1);
+    _level.setTo(cv::Scalar(UNREACHED));
+    _level.at<ushort>(seed) = 0;
+
+    _queues.assign(256, std::vector<cv::Point2i>());
+    _queues[0].push_back(seed);
+    _done = 0;
+}
+
+void
+_LevelGrow::flood(int thresh){
+    int lim = (thresh < 256) ? thresh : 256;
+
+    for (; _done < lim; _done++){
+        std::vector<cv::Point2i>& q = _queues[_done];
+        while (!q.empty()){
+            cv::Point2i p = q.back();
+            q.pop_back();
+
+            /* Pour chaque voisin (même domaine que segmReg) */
+            for (int i=0; i<4; i++){
+                cv::Point2i n = p;
+                switch(i){
+                case 0: n.x++; break;
+                case 1: n.y++; break;
+                case 2: n.x--; break;
+                case 3: n.y--; break;
+                }
+                if (n.x <= 0 || n.y <= 0 || n.x >= _ims.cols || n.y >= _ims.rows)
+                    continue;
+
+                // Le premier niveau attribué est le plus petit : les
+                // niveaux sont traités dans l'ordre croissant
+                ushort& l = _level.at<ushort>(n);
+                if (l != UNREACHED)  continue;
+
+                int d = std::abs((int)(_ims.at<uchar>(n)) - _val);
+                int c = (d > _done) ? d : _done;
+                l = c;
+                _queues[c].push_back(n);
+            }
+        }
+    }
+}
+
+void
+_LevelGrow::region(int thresh, cv::Mat& imd){
+    flood(thresh);
+
+    cv::compare(_level, cv::Scalar(thresh), imd, cv::CMP_LT);
+    imd.at<uchar>(_seed) = 255;
+}
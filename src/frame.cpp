@@ -0,0 +1,111 @@
+
+#include "include/frame.h"
+
+
+struct Frame::_Data : public QSharedData {
+    _Data() {}
+    explicit _Data(const cv::Mat& m) : img(m) {}
+
+    // Copie sur écriture : seuls les pixels sont dupliqués
+    _Data(const _Data& o) : QSharedData(o), img(o.img.clone()) {}
+
+    cv::Mat img;
+    cv::Mat gray;   /**< Niveaux de gris, vide tant qu'ils ne sont pas demandés */
+};
+
+
+Frame::Frame() :
+    d(new _Data){
+}
+
+Frame::Frame(const cv::Mat &img) :
+    d(new _Data(img)){
+}
+
+Frame::Frame(const Frame &o) :
+    d(o.d){
+}
+
+Frame::~Frame(){
+}
+
+Frame&
+Frame::operator=(const Frame &o){
+    d = o.d;
+    return *this;
+}
+
+
+bool
+Frame::isNull() const{
+    return d->img.data == NULL;
+}
+
+int
+Frame::width() const{
+    return d->img.cols;
+}
+
+int
+Frame::height() const{
+    return d->img.rows;
+}
+
+qint64
+Frame::bytes() const{
+    return qint64(d->img.total()) * d->img.elemSize();
+}
+
+
+const cv::Mat&
+Frame::mat() const{
+    return d->img;
+}
+
+const cv::Mat&
+Frame::gray() const{
+    if (d->gray.empty() && !d->img.empty()){
+        if (d->img.channels() == 3 || d->img.channels() == 4)
+            cv::cvtColor(d->img, d->gray, cv::COLOR_RGB2GRAY);
+        else
+            d->gray = d->img;
+    }
+    return d->gray;
+}
+
+
+cv::Mat&
+Frame::edit(){
+    // Partagé avec une autre Frame (avant de toucher au cache des
+    // niveaux de gris, qui reste valide pour les autres détenteurs)
+    d.detach();
+
+    // Les niveaux de gris peuvent partager le tampon (image déjà grise)
+    d->gray.release();
+    // Partagé avec un cv::Mat extérieur
+    detach(d->img);
+
+    return d->img;
+}
+
+
+void
+Frame::detach(cv::Mat &m){
+    if (isShared(m))
+        m = m.clone();
+}
+
+void
+Frame::detachOutput(cv::Mat &m){
+    if (isShared(m))
+        m.release();
+}
+
+bool
+Frame::isShared(const cv::Mat &m){
+#if CV_MAJOR_VERSION >= 3
+    return m.u != NULL && m.u->refcount > 1;
+#else
+    return m.refcount != NULL && *(m.refcount) > 1;
+#endif
+}
@@ -0,0 +1,118 @@
+
+#include "include/framecache.h"
+
+FrameCache::FrameCache(qint64 budget) :
+    _budget(budget),
+    _bytes(0),
+    _hits(0),
+    _misses(0){
+}
+
+
+void
+FrameCache::setBudget(qint64 bytes){
+    _budget = bytes;
+}
+
+qint64
+FrameCache::budget() const{
+    return _budget;
+}
+
+
+bool
+FrameCache::find(int id, Frame &img){
+    QHash<int, Entry>::iterator it = _entries.find(id);
+    if (it == _entries.end()){
+        _misses++;
+        return false;
+    }
+
+    _hits++;
+    _lru.splice(_lru.begin(), _lru, it.value().pos);
+    img = it.value().img;
+    return true;
+}
+
+bool
+FrameCache::peek(int id, Frame &img) const{
+    QHash<int, Entry>::const_iterator it = _entries.find(id);
+    if (it == _entries.end())  return false;
+
+    img = it.value().img;
+    return true;
+}
+
+bool
+FrameCache::contains(int id) const{
+    return _entries.contains(id);
+}
+
+
+void
+FrameCache::insert(int id, const Frame &img){
+    QHash<int, Entry>::iterator it = _entries.find(id);
+    if (it != _entries.end()){
+        _bytes -= it.value().img.bytes();
+        _lru.erase(it.value().pos);
+        _entries.erase(it);
+    }
+
+    _lru.push_front(id);
+    Entry e;
+    e.img = img;
+    e.pos = _lru.begin();
+    _entries.insert(id, e);
+    _bytes += img.bytes();
+}
+
+
+void
+FrameCache::trim(int lo, int hi, int keep){
+    // Parcours du plus ancien au plus récent : hors de [lo;hi], puis
+    // dans [lo;hi] si le budget n'est toujours pas respecté
+    for (int pass=0; pass<2 && _bytes > _budget; pass++){
+        std::list<int>::iterator it = _lru.end();
+        while (_bytes > _budget && it != _lru.begin()){
+            --it;
+            int id = *it;
+            if (id == keep)  continue;
+            if (pass == 0 && id >= lo && id <= hi)  continue;
+
+            QHash<int, Entry>::iterator e = _entries.find(id);
+            _bytes -= e.value().img.bytes();
+            _entries.erase(e);
+            it = _lru.erase(it);
+        }
+    }
+}
+
+
+void
+FrameCache::clear(){
+    _entries.clear();
+    _lru.clear();
+    _bytes = 0;
+}
+
+
+qint64
+FrameCache::bytes() const{
+    return _bytes;
+}
+
+int
+FrameCache::size() const{
+    return _entries.size();
+}
+
+quint64
+FrameCache::hits() const{
+    return _hits;
+}
+
+quint64
+FrameCache::misses() const{
+    return _misses;
+}
+
@@ -0,0 +1,173 @@
+
+#include <QRunnable>
+#include <QMetaObject>
+
+#include "include/frameloader.h"
+
+
+/**
+ * @brief Décodage d'un fichier dans un thread du pool
+ */
+class FrameLoader::_DecodeTask : public QRunnable {
+public:
+    _DecodeTask(FrameLoader* l, int id, const QString& f, int g) :
+        _loader(l), _id(id), _fileName(f), _generation(g) {}
+
+    void run(){
+        cv::Mat img;
+
+        // Requête annulée avant d'avoir commencé : on ne lit pas le fichier
+        if (_loader->_generation.load() == _generation)
+            img = cv::imread(_fileName.toStdString());
+
+        QMetaObject::invokeMethod(_loader, "decoded", Qt::QueuedConnection,
+                                  Q_ARG(int, _id), Q_ARG(int, _generation),
+                                  Q_ARG(Frame, Frame(img)));
+    }
+
+private:
+    FrameLoader* _loader;
+    int _id;
+    QString _fileName;
+    int _generation;
+};
+
+
+
+FrameLoader::FrameLoader(QObject *parent) :
+    QObject(parent),
+    _generation(0),
+    _ahead(3), _behind(1), _center(0),
+    _frameBytes(0)
+{
+    qRegisterMetaType<Frame>("Frame");
+
+    // Lecture de fichiers : peu de threads suffisent
+    _pool.setMaxThreadCount(2);
+}
+
+FrameLoader::~FrameLoader(){
+    cancel();
+    _pool.waitForDone();
+}
+
+
+void
+FrameLoader::setFileNames(const QVector<QString> &fileNames){
+    cancel();
+    _fileNames = fileNames;
+    _cache.clear();
+}
+
+void
+FrameLoader::appendFileName(const QString &fileName){
+    _fileNames.append(fileName);
+}
+
+void
+FrameLoader::setWindow(int ahead, int behind){
+    _ahead = (ahead < 0) ? 0 : ahead;
+    _behind = (behind < 0) ? 0 : behind;
+}
+
+
+void
+FrameLoader::setCacheBudget(qint64 bytes){
+    _cache.setBudget(bytes);
+    trim();
+}
+
+const FrameCache&
+FrameLoader::cache() const{
+    return _cache;
+}
+
+
+bool
+FrameLoader::frame(int id, Frame &img) const{
+    return _cache.peek(id, img);
+}
+
+
+bool
+FrameLoader::prefetch(int id){
+    Frame img;
+    bool hit = _cache.find(id, img);
+
+    int ahead, behind;
+    window(ahead, behind);
+
+    // Saut hors de la fenêtre : les requêtes en attente sont périmées
+    if (id > _center + ahead || id < _center - behind)
+        cancel();
+    _center = id;
+
+    // L'image demandée d'abord, puis les suivantes, puis les précédentes
+    request(id, ahead + behind + 1);
+    for (int i=1; i<=ahead; i++)
+        request(id + i, ahead - i + 1);
+    for (int i=1; i<=behind; i++)
+        request(id - i, 0);
+
+    return hit;
+}
+
+
+void
+FrameLoader::window(int &ahead, int &behind) const{
+    ahead = _ahead;
+    behind = _behind;
+    if (_frameBytes <= 0)  return;
+
+    // Nombre d'images qui tiennent dans le budget, en plus de la courante
+    qint64 n = _cache.budget() / _frameBytes - 1;
+    if (n < 0)  n = 0;
+    if (ahead > n)  ahead = n;
+    if (behind > n - ahead)  behind = n - ahead;
+}
+
+
+void
+FrameLoader::trim(){
+    int ahead, behind;
+    window(ahead, behind);
+    _cache.trim(_center - behind, _center + ahead, _center);
+}
+
+
+void
+FrameLoader::cancel(){
+    _generation.fetchAndAddOrdered(1);
+    _pool.clear();
+    _pending.clear();
+}
+
+
+void
+FrameLoader::request(int id, int priority){
+    if (id < 0 || id >= _fileNames.size())  return;
+    if (_cache.contains(id) || _pending.contains(id))  return;
+
+    _pending.insert(id);
+    _pool.start(new _DecodeTask(this, id, _fileNames[id], _generation.load()),
+                priority);
+}
+
+
+void
+FrameLoader::decoded(int id, int generation, Frame img){
+    // Résultat d'une requête annulée
+    if (generation != _generation.load())  return;
+
+    _pending.remove(id);
+
+    if (!img.isNull())
+        _frameBytes = img.bytes();
+
+    // L'image est gardée même si elle est sortie de la fenêtre entre
+    // temps : seul le budget du cache décide des images libérées
+    _cache.insert(id, img);
+    trim();
+
+    emit frameReady(id);
+}
@@ -4,7 +4,8 @@
 #include <QObject>
 #include <QWidget>
 #include <QMainWindow>
-#include <QDomDocument>
+#include <QIODevice>
+#include <QXmlStreamWriter>
 
 class MainWindow;
 
@@ -49,24 +50,33 @@ public slots:
     virtual void disable() = 0;
 
     /**
-     * @brief Retourne les résultats obtenus sous forme de document DOM
-     * @return un QDomDocument représentant les résultats obtenus
-     * @see updateXml
+     * @brief Écrit les résultats obtenus en XML dans `device`.
+     *
+     * Le document est écrit au fil de l'eau (@see writeXml) : aucun
+     * arbre DOM n'est construit, la mémoire utilisée ne dépend pas du
+     * nombre d'images ni de cellules.
+     *
+     * @return faux en cas d'erreur d'écriture
      */
-    virtual QDomDocument* getXml();
+    bool saveXml(QIODevice* device);
 
 protected:
     /**
-     * @brief Instructions permettant de créer le document XML présentant
-     * les résultats obtenus (appelé par `getXml()`)
-     * @see getXml
+     * @brief Instructions permettant d'écrire les résultats obtenus
+     * (appelé par `saveXml()`), élément racine compris. Le DOCTYPE est
+     * déjà écrit.
+     * @see saveXml
      */
-    virtual void updateXml() = 0;
+    virtual void writeXml(QXmlStreamWriter& xml) = 0;
+
+    /**
+     * @brief Nom du DOCTYPE du document de résultats
+     */
+    virtual QString xmlDocType() const = 0;
 
 protected:
     MainWindow* _window;
     QWidget* _ui;
-    QDomDocument _data;
 
     bool _enabled;
 };
@@ -1,7 +1,15 @@
 #ifndef CONTOURS
 #define CONTOURS
 
+#include <QListWidgetItem>
+#include <QMap>
+
 #include "lib/qcustomplot.h"
+#include "lib/cellcounter.h"
+#include "lib/shapedescriptor.h"
+#include "lib/fourierbatch.h"
+#include "lib/cellindex.h"
+#include "lib/celltable.h"
 
 #include "viewercvgl.h"
 #include "player.h"
@@ -54,6 +62,52 @@ private:
 };
 
 
+/**
+ * @brief Croissance de région incrémentale pour le prédicat "Valeur".
+ *
+ * Chaque pixel p reçoit un niveau L(p) : le plus petit, sur les chemins
+ * (v4) reliant le germe à p, de l'écart maximal |ims - valeur du germe|
+ * le long du chemin. La région obtenue par croissance avec
+ * _ValuePredicate(valeur, t) est exactement { p : L(p) < t }, plus le
+ * germe.
+ *
+ * Les niveaux sont calculés par inondation par priorité (une file par
+ * niveau, 256 niveaux), dans l'ordre croissant : l'inondation s'arrête au
+ * seuil demandé et reprend là où elle s'était arrêtée si un seuil plus
+ * grand est demandé ensuite. Changer de seuil ne coûte donc qu'une
+ * comparaison de la carte des niveaux au seuil.
+ *
+ * @see _ValuePredicate, Contours::segmReg
+ */
+class _LevelGrow {
+public:
+    _LevelGrow();
+
+    /**
+     * @brief Nouvelle image ou nouveau germe : les niveaux sont oubliés
+     */
+    void reset(const cv::Mat& ims, const cv::Point2i& seed);
+
+    /**
+     * @brief Région du germe pour le seuil `thresh`
+     * @param imd  [out] masque (255 dans la région)
+     */
+    void region(int thresh, cv::Mat& imd);
+
+private:
+    void flood(int thresh); /**< Fixe les niveaux des pixels de niveau < thresh */
+
+    static const ushort UNREACHED = 0xFFFF;
+
+    cv::Mat _ims;       /**< Image source (CV_8UC1) */
+    cv::Point2i _seed;
+    int _val;           /**< Valeur du germe */
+    cv::Mat _level;     /**< Niveaux (CV_16UC1), UNREACHED si pas encore atteint */
+    std::vector<std::vector<cv::Point2i> > _queues; /**< Pixels à traiter, par niveau */
+    int _done;          /**< Les niveaux < _done sont entièrement traités */
+};
+
+
 /**
  * @brief Composant "Contours".
  * Permet d'extraire des descripteurs de contours d'une cellule
@@ -62,7 +116,10 @@ private:
  * * Signature polaire
  *
  * La sélection se fait par croissance de région sur un germe
- * défini à la souris.
+ * défini à la souris. Avec le prédicat "Valeur" et l'algorithme
+ * incrémental (par défaut), la région est calculée à partir d'une carte
+ * des niveaux (@see _LevelGrow) : déplacer le curseur du seuil ne
+ * relance pas la croissance.
  */
 class Contours : public Component {
 
@@ -94,17 +151,88 @@ public slots:
     void setThresh(int t);          /**< Seuil pour le critère d'homogénéïté */
     void setHomoType(int h);        /**< Critère d'homogénéïté */
     void setHarmNb(int n);          /**< Nombre d'harmoniques à prendre en compte **/
+    void setGrowAlgo(int a);        /**< Algorithme de croissance de région */
 
     void displayContours(bool d);
 
+    /**
+     * @brief Segmente automatiquement toutes les cellules de l'image.
+     *
+     * Un germe est placé dans chaque forme détectée par la chaine de
+     * comptage (@see setAutoSeedParams), puis les croissances de région
+     * sont calculées en parallèle. Le résultat est une image des labels
+     * (`_labels`) et les descripteurs de chaque cellule (`_cells`).
+     */
+    void segmentAll();
+
+    /**
+     * @brief Cherche dans l'index (@see _index) les cellules les plus
+     * proches de la cellule sélectionnée. Elles sont listées dans
+     * l'interface, et celles de l'image affichée sont entourées.
+     */
+    void findSimilar();
+
+    /**
+     * @brief Affiche l'image de la cellule similaire `item` de la liste,
+     * centrée sur la cellule
+     * @see findSimilar
+     */
+    void showSimilar(QListWidgetItem* item);
+
     void render();
 
+public:
+    /**
+     * @brief Paramètres de la chaine de comptage utilisée pour placer
+     * les germes de la segmentation automatique
+     * @see segmentAll
+     */
+    void setAutoSeedParams(const CellCounter::Params& p);
+
+    /**
+     * @brief Enregistre les cellules segmentées automatiquement de toutes
+     * les images, par ordre d'image, dans un fichier binaire par colonnes
+     * (@see CellTable)
+     * @return faux en cas d'erreur d'écriture
+     */
+    bool saveCells(const QString& fileName) const;
+
 protected:
     void init();
     void initPlots();
-    virtual void updateXml();
+    /**
+     * @brief Descripteurs de la cellule sélectionnée, puis des cellules
+     * segmentées automatiquement.
+     *
+     * Les harmoniques ne sont pas les mêmes pour les deux :
+     * * cellule sélectionnée, `<fourier><harm n="i">` : coefficients bruts
+     *   de la transformée de la variation de la tangente
+     *   (@see ShapeDescriptor::fourierDesc)
+     * * cellules automatiques, `<harmoniques longueur="L"><module n="k">` :
+     *   |F_k| / L pour k de 1 à N, contour rééchantillonné à L points
+     *   (@see FourierBatch)
+     */
+    virtual void writeXml(QXmlStreamWriter& xml);
+    virtual QString xmlDocType() const;
+
+    /**
+     * @brief Élément XML des descripteurs de moments : aire et invariants
+     * de Hu dans [hu;huEnd)
+     */
+    static void writeMoments(QXmlStreamWriter& xml, double area,
+                             const double* hu, const double* huEnd);
 
-    void updatePolarDesc(const QVector<double>& a, const QVector<double>& m);
+    void renderCells();     /**< Dessine les cellules segmentées automatiquement */
+    void drawSimilar();     /**< Entoure les cellules similaires de l'image affichée */
+
+    /**
+     * @brief Vecteur de descripteurs d'une cellule pour l'index : signature
+     * polaire (variance, pics), harmoniques, puis invariants de Hu en
+     * échelle logarithmique signée
+     */
+    static std::vector<double> indexVector(const std::vector<double>& polar,
+                                           const std::vector<double>& fourier,
+                                           const std::vector<double>& hu);
 
     /**
      * @brief Dessiner les QCustomPlot consernant la forme sélectionnée :
@@ -138,6 +266,38 @@ protected:
                  BinaryPredicate hmg, /**< Critère d'homogénéïté (implémente operator(cv::Mat, cv::Point)) */
                  const cv::Point& seed);    /**< Germe */
 
+    /**
+     *  Segmentation par croissance de région, par segments de ligne
+     *  (scanline).
+     *
+     *  Même résultat que segmReg() pour un prédicat sans état
+     *  (_ValuePredicate) : chaque pixel accepté est marqué dans une carte
+     *  des visites compacte (1 bit par pixel), et les segments de pixels
+     *  acceptés sont empilés plutôt que les pixels eux-mêmes.
+     *
+     *  @see segmReg
+     */
+    template<class BinaryPredicate>
+    static void
+    segmRegScanline(const cv::Mat& ims,     /**< Image source */
+                    cv::Mat& imd,           /**< Image de destination */
+                    BinaryPredicate hmg,    /**< Critère d'homogénéïté */
+                    const cv::Point& seed); /**< Germe */
+
+    /**
+     * @brief Foncteur de croissance de région et de calcul des
+     * descripteurs pour un germe (segmentation automatique)
+     * @see segmentAll
+     */
+    struct _GrowCell;
+
+    /**
+     * @brief Croissance de région depuis `_seed` avec l'algorithme
+     * `_growAlgo`
+     */
+    template<class BinaryPredicate>
+    void grow(const cv::Mat& ims, cv::Mat& imd, BinaryPredicate hmg);
+
 protected:
     /**
      * @return le voisin `n` en connectivité v4 du point `p` si `n` est
@@ -163,6 +323,18 @@ protected:
         VAL, MEAN
     };
 
+    /**
+     * @brief Algorithmes de croissance de région. LEVELS n'existe que
+     * pour le prédicat "Valeur" ; avec un autre prédicat, la croissance
+     * se fait par segments de ligne.
+     * @see segmReg
+     * @see segmRegScanline
+     * @see _LevelGrow
+     */
+    enum GrowAlgo{
+        SCANLINE, STACK, LEVELS
+    };
+
 protected:
     ViewerCVGl* _viewer;        /**< Widget d'affichage des images */
     Player* _player;            /**< Lecteur d'images */
@@ -178,24 +350,28 @@ protected:
     QCPBars* _fourierCurve;
     QCPCurve* _firstB; // Première biscectrice pour l'affichage
 
-    cv::Mat _origin;            /**< Image d'origine en niveaux de gris */
-    cv::Mat _originColor;       /**< Image d'origine en couleur */
-    cv::Mat _rendered;          /**< Image à afficher après traitements */
+    cv::Mat _origin;            /**< Image d'origine en niveaux de gris (lecture seule) */
+    Frame _originColor;         /**< Image d'origine en couleur (partagée avec l'afficheur) */
+    Frame _rendered;            /**< Image à afficher, copiée seulement si on dessine dessus */
     cv::Mat _mask;              /**< Masque de la forme à analyser */
 
     std::vector<double> _fourierDesc; /**< Descripteur de fourier du contour */
-
-    /**
-     * Descripteur basé sur la signature polaire.
-     * Descripteur à trois dimensions :
-     * * variance de la signature
-     * * nombre de groupes de points au dessus de la médiane (nombre de "pics")
-     * * nombre moyen de points par angle dans la signature
-     */
-    std::vector<double> _polarDesc;
+    std::vector<double> _polarDesc;   /**< @see ShapeDescriptor::polarDesc */
+    ShapeDescriptor::Moments _moments; /**< Moments de la forme (non pondérés) */
+
+    CellCounter::Params _autoSeedParams;        /**< Placement des germes automatiques */
+    cv::Mat _labels;                            /**< Labels des cellules (CV_32SC1, 0 = fond) */
+    std::vector<ShapeDescriptor::Cell> _cells;  /**< Cellules segmentées automatiquement */
+    FourierBatch _fourierBatch;                 /**< Descripteurs de Fourier des cellules */
+    CellIndex _index;                           /**< Cellules de toutes les images segmentées */
+    QMap<int, std::vector<ShapeDescriptor::Cell> > _frameCells; /**< Cellules segmentées, par image @see saveCells */
+    std::vector<CellIndex::Match> _similar;     /**< Résultat de la dernière recherche @see findSimilar */
+    int _similarSel;                            /**< Cellule similaire affichée (-1 si aucune) */
 
     cv::Point2i _seed;          /**< Germe pour la croissance de région */
     int _thresh;                /**< Seuil du critère pour la croissance de région */
+    _LevelGrow _levelGrow;      /**< Croissance incrémentale (prédicat "Valeur") */
+    bool _levelValid;           /**< `_levelGrow` correspond à l'image et au germe */
     bool _editSeed;             /**< Édite-t-on le germe ? */
     bool _seedPlaced;           /**< Le germe a été placé par l'utilisateur */
 
@@ -204,6 +380,7 @@ protected:
     int _harmNb;                /**< Nombre d'harmoniques */
 
     HomoPredicateType _homPred; /**< Prédicat d'homogénéïté pour la croissance de région */
+    GrowAlgo _growAlgo;         /**< Algorithme de croissance de région */
 
     bool _init;                 /**< Le composant a été initialisé */
 };
@@ -0,0 +1,81 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
+#include <QMetaType>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Image partagée en lecture seule entre le lecteur, l'afficheur
+ * et les composants
+ *
+ * Copier une Frame ne copie pas les pixels : toutes les copies partagent
+ * le même tampon, compté par référence. Les pixels ne sont dupliqués que
+ * lorsqu'un détenteur veut les modifier (copie sur écriture @see edit),
+ * et seulement si le tampon est effectivement partagé.
+ *
+ * La version en niveaux de gris est calculée à la première demande et
+ * partagée par toutes les copies.
+ *
+ * Le compteur de références est atomique : une Frame peut être créée
+ * dans un thread de décodage puis transmise à l'interface. gray() et
+ * edit() ne doivent pas être appelées depuis plusieurs threads à la fois.
+ *
+ * @see Player, ViewerCVGl
+ */
+class Frame {
+
+public:
+    Frame();
+
+    /**
+     * @brief Adopte le tampon de `img`, sans copie. L'appelant ne doit
+     * plus modifier ce tampon ensuite (@see edit, detach).
+     */
+    explicit Frame(const cv::Mat& img);
+
+    // `_Data` n'est défini que dans frame.cpp : copie et destruction y
+    // sont aussi définies
+    Frame(const Frame& o);
+    ~Frame();
+    Frame& operator=(const Frame& o);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    qint64 bytes() const;   /**< Taille des pixels en octets */
+
+    const cv::Mat& mat() const;   /**< Pixels, en lecture seule */
+    const cv::Mat& gray() const;  /**< Pixels en niveaux de gris (calculés une fois) */
+
+    /**
+     * @brief Pixels modifiables. Ils sont d'abord copiés si une autre
+     * Frame ou un autre cv::Mat partage le tampon.
+     */
+    cv::Mat& edit();
+
+    /**
+     * @brief Copie les pixels de `m` si son tampon est partagé, avant de
+     * le modifier sur place
+     */
+    static void detach(cv::Mat& m);
+
+    /**
+     * @brief Libère `m` si son tampon est partagé, avant de l'utiliser
+     * comme destination d'un traitement qui réécrit tous les pixels : le
+     * traitement alloue alors un nouveau tampon au lieu d'écraser une
+     * image encore affichée
+     */
+    static void detachOutput(cv::Mat& m);
+
+    static bool isShared(const cv::Mat& m); /**< Tampon référencé plusieurs fois */
+
+protected:
+    struct _Data;
+    QExplicitlySharedDataPointer<_Data> d;
+};
+
+Q_DECLARE_METATYPE(Frame)
+
+#endif // FRAME_H
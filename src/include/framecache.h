@@ -0,0 +1,80 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <list>
+#include <QHash>
+
+#include "frame.h"
+
+/**
+ * @brief Cache LRU d'images décodées, borné en mémoire
+ *
+ * Les images sont indexées par leur position dans la liste de lecture.
+ * Lorsque la taille totale dépasse le budget, les images utilisées le
+ * moins récemment sont libérées en premier, en dehors de la fenêtre de
+ * préchargement autour de l'image courante, puis dans la fenêtre si
+ * cela ne suffit pas. Seule l'image courante peut faire dépasser le
+ * budget.
+ *
+ * @see FrameLoader
+ */
+class FrameCache {
+
+public:
+    explicit FrameCache(qint64 budget = 512 * 1024 * 1024);
+
+    /**
+     * @brief Budget mémoire en octets
+     */
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /**
+     * @brief Recherche l'image `id`. Compte un succès ou un échec et
+     * marque l'image comme la plus récemment utilisée.
+     * @return faux si l'image n'est pas dans le cache
+     */
+    bool find(int id, Frame& img);
+
+    /**
+     * @brief Recherche l'image `id`, sans effet sur les statistiques
+     * ni sur l'ordre LRU
+     */
+    bool peek(int id, Frame& img) const;
+    bool contains(int id) const;
+
+    /**
+     * @brief Ajoute (ou remplace) l'image `id`, la plus récemment utilisée
+     */
+    void insert(int id, const Frame& img);
+
+    /**
+     * @brief Libère les images les moins récemment utilisées jusqu'à
+     * respecter le budget : d'abord celles dont l'id n'est pas dans
+     * `[lo;hi]`, puis les autres, sauf l'image `keep`
+     */
+    void trim(int lo, int hi, int keep);
+
+    void clear();   /**< Vide le cache (les statistiques sont conservées) */
+
+    qint64 bytes() const;   /**< Taille actuelle en octets */
+    int size() const;       /**< Nombre d'images */
+    quint64 hits() const;   /**< Nombre de succès de find() */
+    quint64 misses() const; /**< Nombre d'échecs de find() */
+
+protected:
+    struct Entry {
+        Frame img;
+        std::list<int>::iterator pos; /**< Position dans `_lru` */
+    };
+
+    QHash<int, Entry> _entries;
+    std::list<int> _lru;    /**< Ids, du plus récent au plus ancien */
+
+    qint64 _budget;
+    qint64 _bytes;
+    quint64 _hits;
+    quint64 _misses;
+};
+
+#endif // FRAMECACHE_H
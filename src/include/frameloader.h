@@ -0,0 +1,124 @@
+#ifndef FRAMELOADER_H
+#define FRAMELOADER_H
+
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <QSet>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMetaType>
+#include <opencv2/opencv.hpp>
+
+#include "frame.h"
+#include "framecache.h"
+
+/**
+ * @brief Décodage des images du lecteur en tâche de fond
+ *
+ * Les fichiers sont lus par un pool de threads dédié. Autour de l'image
+ * courante, une fenêtre d'images en avance et en retard est maintenue
+ * décodée, de sorte que le passage à l'image suivante ou précédente
+ * ne bloque jamais l'interface sur une lecture de fichier.
+ *
+ * Les images décodées sont conservées dans un cache LRU borné en mémoire :
+ * revenir sur une image vue récemment ne nécessite pas de la relire.
+ *
+ * Lors d'un saut (première / dernière image), les décodages en attente
+ * devenus inutiles sont annulés : chaque requête porte un numéro de
+ * génération, et les résultats d'une génération périmée sont ignorés.
+ *
+ * @see Player
+ */
+class FrameLoader : public QObject {
+
+    Q_OBJECT
+
+public:
+    explicit FrameLoader(QObject* parent = 0);
+    ~FrameLoader();
+
+    /**
+     * @brief Remplace la liste des fichiers (annule les décodages en cours
+     * et vide les images décodées)
+     */
+    void setFileNames(const QVector<QString>& fileNames);
+    void appendFileName(const QString& fileName); /**< Ajoute un fichier à la liste */
+
+    /**
+     * @brief Taille maximale de la fenêtre de préchargement. Elle est
+     * réduite si ses images ne tiennent pas dans le budget du cache
+     * (@see window).
+     * @param ahead   nombre d'images décodées en avance
+     * @param behind  nombre d'images décodées en retard
+     */
+    void setWindow(int ahead, int behind);
+
+    /**
+     * @brief Budget mémoire du cache d'images décodées, en octets
+     * @see FrameCache
+     */
+    void setCacheBudget(qint64 bytes);
+
+    const FrameCache& cache() const; /**< Statistiques du cache */
+
+    /**
+     * @brief Image décodée `id`, si elle est disponible
+     * @return faux si l'image n'est pas (encore) décodée
+     */
+    bool frame(int id, Frame& img) const;
+
+    /**
+     * @brief Demande le décodage de l'image `id` en priorité, puis de la
+     * fenêtre autour d'elle.
+     * @return vrai si l'image `id` est déjà dans le cache
+     * @see frameReady
+     */
+    bool prefetch(int id);
+
+    /**
+     * @brief Annule toutes les requêtes en attente
+     */
+    void cancel();
+
+signals:
+    /**
+     * @brief L'image `id` vient d'être décodée
+     * @see frame
+     */
+    void frameReady(int id);
+
+protected slots:
+    /** Appelé (dans le thread de l'interface) à la fin d'un décodage */
+    void decoded(int id, int generation, Frame img);
+
+protected:
+    void request(int id, int priority);
+
+    /**
+     * @brief Fenêtre effective : `_ahead` et `_behind`, réduits pour que
+     * la fenêtre, image courante comprise, tienne dans le budget du
+     * cache (d'après la taille de la dernière image décodée). Le retard
+     * est réduit en premier.
+     */
+    void window(int& ahead, int& behind) const;
+
+    void trim(); /**< Applique le budget du cache autour de `_center` */
+
+protected:
+    class _DecodeTask;
+
+    QThreadPool _pool;          /**< Threads de décodage */
+    QAtomicInt _generation;     /**< Génération des requêtes en cours */
+
+    QVector<QString> _fileNames;
+    FrameCache _cache;          /**< Images décodées */
+    QSet<int> _pending;         /**< Images en cours de décodage */
+
+    int _ahead;                 /**< Images décodées en avance */
+    int _behind;                /**< Images décodées en retard */
+    int _center;                /**< Centre de la fenêtre */
+    qint64 _frameBytes;         /**< Taille de la dernière image décodée (0 si aucune) */
+};
+
+#endif // FRAMELOADER_H
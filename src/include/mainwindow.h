@@ -2,7 +2,6 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QDomDocument>
 
 #include "apropos.h"
 #include "parameters.h"
@@ -53,6 +52,22 @@ public slots:
 
     void setPlayerBarRange(int max);
 
+    /**
+     * @brief Applique les réglages de la fenêtre de paramètres
+     */
+    void applyParameters();
+
+    /**
+     * @brief Affiche l'occupation et les statistiques du cache d'images
+     * dans la barre d'état
+     */
+    void updateCacheStatus();
+
+    /**
+     * @brief Affiche la cadence de lecture obtenue dans la barre d'état
+     */
+    void showPlaybackStats(double fps, double targetFps, int dropped);
+
 private:
     void connectSlots(); /**< Connecte les signaux et slots */
 
@@ -32,6 +32,8 @@ public slots:
 public:
     const int& playerDelay() const;  /**< Délais entre chaque image (lecteur) */
     const QColor& annotColor() const;   /**< Couleur des annotations (dessins) */
+    const int& cacheBudget() const;  /**< Taille du cache d'images du lecteur (Mo) */
+    const int& sliceBand() const;    /**< Largeur de la coupe oblique (pixels) */
 
     void accept();
     void reject();
@@ -46,6 +48,8 @@ protected:
 protected:
     int _playerDelay;
     QColor _annotColor;
+    int _cacheBudget;
+    int _sliceBand;
 
 private:
     Ui::Parameters *ui;
@@ -5,18 +5,23 @@
 #include <QFileDialog>
 #include <QVector>
 #include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
 
 #include "viewercvgl.h"
+#include "frameloader.h"
 
 /**
  * @brief Classe gérant le lecteur d'images
  *
  * La classe player est utilisée pour gérer le
- * lecteur de fichiers images. Dans la mesure
- * où les fichiers sont lus à la volée, le temps
- * de latence entre chaque image est limité. Il
- * est calculé lors de la lecture du premier
- * fichier.
+ * lecteur de fichiers images. Les fichiers sont
+ * décodés en tâche de fond par un FrameLoader,
+ * qui précharge les images autour de l'image
+ * courante : l'interface n'attend jamais la
+ * lecture d'un fichier.
+ *
+ * @see FrameLoader
  */
 class Player : public QObject{
 
@@ -30,17 +35,17 @@ public:
 
     ~Player();
 
-    /*
-     * Utilisation du buffer
-     * circulaire
-     */
 public:
-    void setCurrent(const int& id);  /**< Lit et enregistre le fichier à afficher*/
-    void setPrevious(const int& id); /**< Lit et enregistre le fichier précédent */
-    void setNext(const int& id);  /**< Lit et enregistre le prochain fichier */
-
     int fileListLength();
     int currentId();
+    /**
+     * @brief Id de l'image actuellement affichée (-1 si aucune) : celle
+     * qu'analysent les composants. Diffère de `currentId` tant que
+     * l'image demandée n'est pas encore décodée.
+     */
+    int shownId();
+    const QVector<QString>& fileNames() const; /**< Liste de lecture */
+    const FrameCache& cache() const;  /**< Cache des images décodées (statistiques) */
 
 
     /*
@@ -74,6 +79,13 @@ public slots:
     void nextImg();     /**< Affiche l'image suivante du buffer */
     void previousImg(); /**< Affiche l'image précédente du buffer (rwd) */
 
+    /**
+     * @brief Passe à l'image `id` : elle est affichée dès qu'elle est
+     * décodée, et la fenêtre de préchargement est déplacée autour d'elle.
+     * Arrête la lecture en cours.
+     */
+    void showFrame(int id);
+
     void openFileDialog();
     void openDirDialog();
 
@@ -81,8 +93,14 @@ public slots:
      * Slots
      */
 public slots:
+    /**
+     * @brief Lance ou met en pause la lecture. Les images sont affichées
+     * toutes les `_timeStep` ms ; si le décodage prend du retard, les
+     * images non prêtes à temps sont sautées.
+     * @see playbackStats
+     */
     void playPause();
-    void stop();
+    void stop();     /**< Arrête la lecture et revient à la première image */
     void forward();
     void rewind();
     void first();
@@ -90,40 +108,62 @@ public slots:
 
     void setTimeStep(int ts);
 
+    /**
+     * @brief Nombre d'images décodées à l'avance autour de l'image courante
+     * @see FrameLoader::setWindow
+     */
+    void setPrefetchWindow(int ahead, int behind);
+
+    /**
+     * @brief Mémoire maximale occupée par les images décodées, en Mo
+     * @see FrameCache
+     */
+    void setCacheBudget(int mb);
+
 signals:
     void fileListChangedLen(int l);
     void fileListIdChanged(int i);
 
-    /*
-     * Protected functions
-     */
-protected:
+    void playingChanged(bool playing);  /**< Début / fin de la lecture */
+
     /**
-     * Créer le buffer en fonction du premier fichier de la liste.
-     * Le fichier est alors lu et l'image est considérée comme
-     * l'image courante (et est affichée).
+     * @brief Statistiques de lecture, émises à chaque image affichée
+     * @param fps        cadence obtenue (images/s)
+     * @param targetFps  cadence demandée (images/s)
+     * @param dropped    nombre d'images sautées depuis le début de la lecture
      */
-    void createBuffer();
+    void playbackStats(double fps, double targetFps, int dropped);
 
-    int nxtBufferId();
-    int prvBufferId();
+protected slots:
+    /** Une image vient d'être décodée par `_loader` */
+    void frameReady(int id);
+
+    /** Affiche l'image attendue à l'instant présent pendant la lecture */
+    void playTick();
 
 protected:
     ViewerCVGl* _viewer;
+    FrameLoader* _loader;   /**< Décodage des images en tâche de fond */
 
     QVector<QString> _fileNames;
     QString _dirName;
-    QVector<cv::Mat> _buffer; /**< Buffer circulaire */
 
     int _timeStep;  /**< Temps entre deux images en ms*/
-    int _currentId; /**< Id de l'image actuellement affichée */
-    int _curBufferId; /**< Id de la case actuelle du buffer */
+    int _currentId; /**< Id de l'image à afficher */
+    int _shownId;   /**< Id de l'image actuellement affichée (-1 si aucune) */
 
     QFileDialog* _fileDialog;
     QFileDialog* _dirDialog;
 
     bool _playing;
     bool _init;
+
+    QTimer _playTimer;          /**< Cadence de la lecture */
+    QElapsedTimer _playClock;   /**< Temps écoulé depuis le début de la lecture */
+    int _playStartId;           /**< Image de départ de la lecture */
+    int _playTarget;            /**< Image attendue au dernier tick */
+    int _playedFrames;          /**< Images affichées depuis le début de la lecture */
+    int _droppedFrames;         /**< Images sautées depuis le début de la lecture */
 };
 
 #endif // PLAYER_H
@@ -2,8 +2,14 @@
 #define POPULATION
 
 #include <QGridLayout>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QAtomicInt>
 #include <opencv2/opencv.hpp>
 
+#include "lib/cellcounter.h"
+#include "lib/resultjournal.h"
+
 #include "viewercvgl.h"
 #include "player.h"
 #include "component.h"
@@ -20,6 +26,10 @@ class Population : public Component {
 
     Q_OBJECT
 
+public:
+    /** Nom du journal des comptages, dans le répertoire des images */
+    static const char* const JOURNAL_NAME;
+
 public:
     Population(MainWindow* w,        /**< Fenêtre parente */
                QWidget* ui,          /**< Layout utilisé */
@@ -28,6 +38,13 @@ public:
            );
     ~Population();
 
+    /**
+     * @brief Paramètres actuels de la chaine de traitements, utilisables
+     * pour compter d'autres images sans passer par l'interface
+     * @see CellCounter
+     */
+    CellCounter::Params countParams() const;
+
 public slots:
     //virtual void setEnabled(bool e); /**< Activer / désactiver le module */
     void setThresh(int t);
@@ -39,6 +56,12 @@ public slots:
     void invThresh(bool i);  /**< Seuillage inverse */
     void enThresh(bool e);   /**< Activer le seuillage */
 
+    /**
+     * @brief Seuil manuel, ou calculé sur l'histogramme de chaque image
+     * @param m  indice dans CellCounter::ThreshMode
+     */
+    void setThreshMode(int m);
+
     void equalize();      /**< Égaliser l'histogramme */
     void resetLinear();   /**< Remise à zéro des transformations linéaires */
 
@@ -46,6 +69,20 @@ public slots:
     void erode();         /**< Éroder */
 
     void count();         /**< Compter les cellules */
+
+    /**
+     * @brief Compter les cellules de toutes les images du lecteur.
+     * Les fichiers sont lus et traités en parallèle avec les paramètres
+     * actuels ; le tableau est rempli au fur et à mesure.
+     *
+     * Chaque résultat est ajouté au journal `JOURNAL_NAME` du répertoire
+     * des images : les images déjà comptées avec les mêmes paramètres
+     * (et non modifiées depuis) ne sont pas recomptées.
+     * @see CellCounter
+     * @see ResultJournal
+     */
+    void countAll();
+    void cancelCountAll();  /**< Interrompre le comptage de toutes les images */
     void resetDisplay();  /**< Afficher l'image d'origine */
 
     void render();
@@ -55,34 +92,71 @@ public slots:
     void disable();
     void updateTableSize(int columns);
 
+protected slots:
+    void countAllResult(int id);  /**< Un résultat de countAll() est disponible */
+    void countAllFinished();
+
 protected:
     void init();
 
-    void linearTransform(const cv::Mat& src);
-
-    virtual void updateXml();
+    /**
+     * @brief Recalcule la table de la transformation linéaire après un
+     * changement de contraste ou de luminosité
+     * @see CellCounter::linearLut
+     */
+    void updateLut();
+
+    /**
+     * @brief Seuil à appliquer : `_thresh`, ou seuil automatique calculé
+     * sur l'histogramme de l'image courante (calculé une fois par image,
+     * puis transformé par la table `_lut` à chaque rendu)
+     */
+    int currentThresh();
+
+    /**
+     * @brief Inscrit le nombre `n` de cellules de l'image `id` dans le
+     * tableau et met à jour le minimum et le maximum
+     */
+    void setFrameCount(int id, int n);
+
+    virtual void writeXml(QXmlStreamWriter& xml);
+    virtual QString xmlDocType() const;
 
 protected:
     ViewerCVGl* _viewer;
     Player* _player;
 
-    cv::Mat _origin;    /**< Image d'origine */
-    cv::Mat _rendered;  /**< Image à afficher */
+    Frame _origin;      /**< Image d'origine (partagée avec l'afficheur) */
+    cv::Mat _rendered;  /**< Image affichée */
     cv::Mat _renderedBin; /**< Image binaire à afficher */
 
-    cv::Mat _tmpImage;
+    cv::Mat _tmpImage;  /**< Second tampon de sortie, non affiché @see render */
+    cv::Mat _linear;    /**< Image après transformation linéaire */
+    cv::Mat _lut;       /**< Table de la transformation linéaire */
 
     bool _invThresh;
     int _thresh;
+    CellCounter::ThreshMode _threshMode;
+
+    std::vector<int> _hist;     /**< Histogramme de l'image d'origine en niveaux de gris */
+    bool _histValid;            /**< `_hist` correspond à `_origin` */
     double _contrast;
     int _lumin;
 
     int _eltSize;     /**< Taille de l'élément structurant */
     int _eltShape;    /**< Forme de l'élément structurant @see cv::MORPH_* */
 
+    /** Opérations morphologiques appliquées depuis le dernier rendu */
+    std::vector<CellCounter::Morpho> _morpho;
+
     bool _threshEn;   /**< Seuillage activé */
     bool _init;
 
+    QFutureWatcher<int> _countWatcher; /**< Suivi du comptage de toutes les images */
+    QElapsedTimer _countTimer;
+    ResultJournal _journal;     /**< Résultats déjà calculés @see countAll */
+    QAtomicInt _resumed;        /**< Images reprises du journal au dernier comptage */
+
 };
 
 #endif // POPULATION
@@ -8,6 +8,7 @@
  * Gestion des outils graphiques de coupe :
  * * viewerSliceToolH
  * * viewerSliceToolV
+ * * coupe oblique (affichée dans viewerSliceToolH)
  */
 
 #include <QObject>
@@ -18,6 +19,15 @@
 
 /**
  * @brief Gestion des outils graphiques de coupe.
+ *
+ * Les profils sont lus dans l'image d'origine en niveaux de gris (pleine
+ * résolution), le long des lignes de coupe placées dans l'afficheur :
+ * un point par pixel du cadre, au pixel de l'image qu'il affiche.
+ *
+ * En mode oblique, le segment est tracé à la souris dans l'afficheur
+ * (appui, glisser, relâcher) et le profil, mis à jour pendant le tracé,
+ * remplace le profil horizontal : un point par pixel le long du segment,
+ * moyenné sur une bande perpendiculaire de `band` pixels.
  */
 class SliceTool : public QObject{
 
@@ -28,6 +38,11 @@ public:
 
 public slots:
     bool placeSlice(int x, int y); /**< Place les axes et désactive l'édition */
+    void dragSlice(int x, int y);    /**< Déplace l'extrémité de la coupe oblique */
+    void releaseSlice(int x, int y); /**< Termine le tracé de la coupe oblique */
+
+    void setOblique(bool o);  /**< Active la coupe oblique */
+    void setBand(int band);   /**< Largeur de la bande moyennée (pixels) */
 
     void editH();        /**< Active l'édition des axes de coupe */
     void editV();
@@ -38,17 +53,45 @@ public slots:
     void update(bool h, bool v);
     void update();
 
+public:
+    /**
+     * @brief Profil le long du segment [a;b] de l'image `gray` (8 bits),
+     * échantillonné tous les pixels par interpolation bilinéaire, et
+     * moyenné sur `band` segments parallèles espacés d'un pixel
+     * @param keys    [out] distance à `a` (pixels ; hors image : omises)
+     * @param values  [out] niveaux de gris moyens
+     */
+    static void lineProfile(const cv::Mat& gray, const QPointF& a, const QPointF& b,
+                            int band, QVector<double>& keys, QVector<double>& values);
+
+protected:
+    /**
+     * @brief Profil le long de la ligne `y` (horizontal) ou de la colonne
+     * `x` (vertical) du cadre de l'afficheur
+     * @param keys    [out] positions dans le cadre (hors image : omises)
+     * @param values  [out] niveaux de gris
+     */
+    void profile(bool horizontal, int pos, QVector<double>& keys, QVector<double>& values) const;
+
 protected:
     QCustomPlot* _hTool;    /**< Pointeur vers le rendu horizontal */
     QCustomPlot* _vTool;    /**< Pointeur vers le rendu vertical */
     ViewerCVGl* _viewer;    /**< Pointeur vers le viewer */
 
-    QVector<int> _hData;    /**< Données horizontales */
-    QVector<int> _vData;    /**< Données verticales */
+    QVector<double> _hKeys; /**< Abscisses horizontales (pixels du cadre) */
+    QVector<double> _hData; /**< Données horizontales */
+    QVector<double> _vKeys;
+    QVector<double> _vData; /**< Données verticales */
 
     int _x;
     int _y;
 
+    bool _oblique;          /**< Coupe oblique active */
+    bool _dragging;         /**< Tracé de la coupe oblique en cours */
+    QPointF _a;             /**< Extrémités de la coupe oblique (image d'origine) */
+    QPointF _b;
+    int _band;              /**< Largeur de la bande moyennée */
+
     bool _editingH;         /**< Vrai si on est en train d'éditer les axes */
     bool _editingV;
 };
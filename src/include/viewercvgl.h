@@ -3,9 +3,14 @@
 
 #include <QGLWidget>
 #include <QMouseEvent>
+#include <QWheelEvent>
+#include <QHash>
+#include <QPointF>
+#include <vector>
 #include <opencv2/opencv.hpp>
 
 #include "lib/edimageprocessor.h"
+#include "frame.h"
 
 /**
  * @brief The Viewer class
@@ -16,6 +21,18 @@
  * et des éléments graphiques simples comme
  * * Du texte
  * * Des pixels colorés (outil pinceaux rudimentaire)
+ *
+ * L'image est affichée par tuiles de TILE_SIZE pixels, prises dans une
+ * pyramide de résolutions (cv::pyrDown) : seules les tuiles visibles, au
+ * niveau le plus proche du zoom courant, sont traitées par `_imgProc` et
+ * envoyées à la carte graphique. Les tuiles sont gardées en mémoire
+ * graphique tant que l'image et les paramètres de traitement ne changent
+ * pas. Une très grande image reste ainsi fluide à zoomer et déplacer.
+ *
+ * Navigation :
+ * * molette : zoom autour du curseur
+ * * glisser avec le bouton du milieu ou le bouton droit : déplacement
+ * * double-clic : image entière dans le cadre
  */
 class ViewerCVGl : public QGLWidget {
 
@@ -26,6 +43,9 @@ public:
     explicit ViewerCVGl(QWidget *parent = 0);
     ~ViewerCVGl();
 
+    static const int TILE_SIZE = 256; /**< Côté des tuiles, en pixels */
+    static const int MAX_TILES = 256; /**< Nombre de tuiles gardées en mémoire graphique */
+
     void setImgProc(EdImageProcessor* p);
 
     /* Signaux */
@@ -34,6 +54,8 @@ signals:
     void sceneChanged();
     void mouseClicked(int x, int y);      /**< Clique dans le cadre @see mouseClickedImage */
     void mouseClickedImage(int x, int y); /**< Coordonées rapportées à l'image d'origine @see mouseClicked */
+    void mouseDragged(int x, int y);      /**< Déplacement avec le bouton gauche enfoncé (cadre) */
+    void mouseReleased(int x, int y);     /**< Bouton gauche relâché (cadre) */
 
     /* Accesseurs */
 public:
@@ -50,29 +72,55 @@ public:
     const int& imageHeight() const;
 
     /**
-     * @brief Référence vers l'image affichée
+     * @brief Image d'origine traitée, en pleine résolution (calculée à
+     * la demande, l'affichage n'en a pas besoin)
      */
-    const QImage& renderedImage() const;
+    const QImage& renderedImage();
 
     /**
      * @return Référence vers l'image d'origine (non redimentionnée)
      */
     const cv::Mat& originImage() const;
+    const Frame& originFrame() const; /**< Image d'origine, partagée sans copie */
+
+    double zoom() const; /**< Pixels affichés par pixel de l'image */
+
+    /**
+     * @brief Coordonnées dans l'image d'origine du point (x,y) du cadre
+     */
+    QPointF mapToImage(int x, int y) const;
+
+    /**
+     * @brief Coordonnées dans le cadre du point (u,v) de l'image d'origine
+     */
+    QPointF mapToWidget(double u, double v) const;
 
     /* Evénements */
 public:
     void mousePressEvent(QMouseEvent* event);
+    void mouseMoveEvent(QMouseEvent* event);
+    void mouseReleaseEvent(QMouseEvent* event);
+    void mouseDoubleClickEvent(QMouseEvent* event);
+    void wheelEvent(QWheelEvent* event);
 
 
     /* Public slots */
 public slots:
 
     /**
-     * @brief showImage Donne l'image à afficher, et lance le rendering
+     * @brief showImage Donne l'image à afficher, et lance le rendering.
+     * L'image est copiée : l'appelant peut continuer à la modifier.
      * @return vrai si l'image est utilisable
+     * @see showFrame
      */
     bool showImage(cv::Mat image);
 
+    /**
+     * @brief Donne l'image à afficher, sans copie des pixels
+     * @return vrai si l'image est utilisable
+     */
+    bool showFrame(const Frame& frame);
+
     /**
      * @brief refresh Met à jour l'affichage (appel de drawImage)
      * @return vrai si succès
@@ -104,6 +152,13 @@ public slots:
     void setSliceToolX(int x);
     void setSliceToolY(int y);
 
+    /**
+     * @brief Affiche la coupe oblique de `a` à `b` et les bords de sa
+     * bande de largeur `band` (coordonnées de l'image d'origine)
+     */
+    void setSliceSegment(const QPointF& a, const QPointF& b, int band);
+    void hideSliceSegment();
+
     void showTools();
     void hideTools();
 
@@ -112,6 +167,15 @@ public slots:
     void resetDrawings(); /**< Efface les dessins */
     void reset();  /**< Efface l'affichage - dessins et image */
 
+    /**
+     * @brief Change le zoom en gardant fixe le point (x,y) du cadre
+     */
+    void setZoom(double zoom, int x, int y);
+    void zoomIn();       /**< Zoom avant autour du centre du cadre */
+    void zoomOut();      /**< Zoom arrière autour du centre du cadre */
+    void fitToWindow();  /**< Image entière dans le cadre */
+    void centerOn(int x, int y); /**< Centre le cadre sur le point (x,y) de l'image, sans changer le zoom */
+
     /* Protected methods */
 protected:
     void 	initializeGL(); /**< Initialisation d'openGL */
@@ -122,9 +186,39 @@ protected:
 
     bool    drawImage();   /**< Méthode intermédiaire pour l'affichage */
 
+    /**
+     * @brief Applique les traitements à l'image d'origine entière, sauf si
+     * le résultat pour cette image et cette version des paramètres de
+     * `_imgProc` est déjà calculé @see renderedImage
+     * @return vrai si l'image est utilisable
+     */
+    bool    processImage();
+
     void    updateScene();
     void    renderImage();
 
+    /**
+     * @brief Met à jour la position et la taille de l'image dans le cadre
+     * (`_OutW`, `_OutH`, `_PosX`, `_PosY`) à partir du zoom et de la vue
+     */
+    void    updateLayout();
+
+    /**
+     * @brief Niveau `l` de la pyramide (0 : pleine résolution), calculé à
+     * la première demande
+     */
+    const cv::Mat& level(int l);
+    int     levelForZoom() const; /**< Niveau le plus adapté au zoom courant */
+
+    /**
+     * @brief Texture de la tuile (tx,ty) du niveau `l`, traitée et envoyée
+     * à la carte graphique si elle ne l'est pas déjà
+     * @return 0 si l'image traitée n'est pas affichable
+     */
+    GLuint  tile(int l, int tx, int ty);
+    void    clearTiles();    /**< Libère toutes les textures */
+    void    evictTiles();    /**< Libère les tuiles les moins récemment affichées */
+
 
     /* Attributs */
 protected:
@@ -135,19 +229,49 @@ protected:
     int _sliceTooly;
     bool _showTools;
 
+    QPointF _segmentA;  /**< Extrémités de la coupe oblique (image d'origine) */
+    QPointF _segmentB;
+    int _segmentBand;   /**< Largeur de la bande de la coupe oblique */
+    bool _showSegment;
+
     bool _SceneChanged;  /**< Indicates when OpenGL view is to be redrawn */
 
-    QImage _RenderQtImg;   /**< Qt image to be rendered */
-    cv::Mat _OrigImage;    /**< original OpenCV image to be shown */
+    QImage _RenderQtImg;   /**< Image traitée en pleine résolution @see renderedImage */
+    Frame _OrigFrame;      /**< Image d'origine, partagée avec le lecteur et les composants */
+    cv::Mat _OrigImage;    /**< Pixels de `_OrigFrame` (en lecture seule) */
+
+    /* Mémoïsation des rendus */
+    quint64 _OrigVersion;  /**< Incrémenté à chaque nouvelle image d'origine */
+    quint64 _RenderOrigVersion; /**< `_OrigVersion` de `_RenderQtImg` */
+    quint64 _RenderProcVersion; /**< Version de `_imgProc` de `_RenderQtImg` */
+
+    /* Pyramide et tuiles */
+    struct _Tile {
+        GLuint tex;        /**< Texture (TILE_SIZE x TILE_SIZE) */
+        int w, h;          /**< Partie utilisée de la texture */
+        quint64 lastUsed;  /**< Numéro du dernier rendu l'ayant affichée */
+    };
+    std::vector<cv::Mat> _Pyramid;   /**< Niveaux de résolution de `_OrigImage` */
+    QHash<quint64, _Tile> _Tiles;    /**< Tuiles, par (niveau, tx, ty) */
+    quint64 _TilesOrigVersion;  /**< `_OrigVersion` des tuiles */
+    quint64 _TilesProcVersion;  /**< Version de `_imgProc` des tuiles */
+    quint64 _RenderCount;       /**< Nombre de rendus effectués */
+
+    /* Vue */
+    double _Zoom;      /**< Pixels affichés par pixel de l'image */
+    double _ViewX;     /**< Point de l'image au coin sup. gauche du cadre */
+    double _ViewY;
+    bool _FitView;     /**< Image entière dans le cadre, suit les redimensionnements */
+    bool _Panning;     /**< Déplacement à la souris en cours */
+    QPoint _PanLast;   /**< Dernière position de la souris pendant le déplacement */
 
     QColor _BgColor;     /**< Background color */
 
     int _OutH;          /**< Resized Image height */
     int _OutW;          /**< Resized Image width */
-    float _ImgRatio;    /**< height/width ratio */
 
-    int _PosX; /**< Top left X position to render image in the center of widget */
-    int _PosY; /**< Top left Y position to render image in the center of widget */
+    int _PosX; /**< Top left X position of the image in the widget (may be negative) */
+    int _PosY; /**< Top left Y position of the image in the widget (may be negative) */
 
     EdImageProcessor* _imgProc; /**< Traitement des images */
 
@@ -48,6 +48,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     /* Connexion signaux / slots */
     connectSlots();
+    applyParameters();
 }
 
 MainWindow::~MainWindow()
@@ -85,18 +86,29 @@ void MainWindow::saveResults(){
 }
 
 void MainWindow::saveResInFile(QString fileName){
-    QDomDocument* xml;
-    if    (_population->isEnabled()) xml = _population->getXml();
-    else if (_contours->isEnabled()) xml = _contours->getXml();
+    Component* component = 0;
+    if    (_population->isEnabled()) component = _population;
+    else if (_contours->isEnabled()) component = _contours;
+    if (!component)  return;
+
+    // Cellules de la segmentation automatique : format binaire par colonnes
+    if (component == _contours && fileName.endsWith(".cells", Qt::CaseInsensitive)){
+        if (!_contours->saveCells(fileName))
+            std::cerr << "[E] Impossible d'enregistrer le fichier  : "
+                      << fileName.toStdString() << std::endl;
+        return;
+    }
 
+    // Le fichier est écrit au fil de l'eau par le composant
     QFile file(fileName);
-    if (! file.open(QIODevice::ReadWrite | QIODevice::Text)){
+    if (! file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
         std::cerr << "[E] Impossible d'enregistrer le fichier  : "
                   << fileName.toStdString() << std::endl;
     }
     else{
-        QTextStream out(&file);
-        xml->save(out, 2);
+        if (!component->saveXml(&file))
+            std::cerr << "[E] Erreur d'écriture du fichier : "
+                      << fileName.toStdString() << std::endl;
         file.close();
     }
 }
@@ -113,6 +125,7 @@ void MainWindow::enableContours(bool e){
 
     if (e){
         ui->pluginTab->setCurrentIndex(1);
+        _contours->setAutoSeedParams(_population->countParams());
     }
 
     _contours->setEnabled(e);
@@ -137,6 +150,9 @@ void MainWindow::connectSlots(){
     QObject::connect(ui->actionOutil_de_coupe_horizontale, SIGNAL(triggered()),
                      this, SLOT(showHideGraphicTools()));
 
+    QObject::connect(ui->actionOutil_de_coupe_oblique, SIGNAL(triggered()),
+                     this, SLOT(showHideGraphicTools()));
+
     QObject::connect(ui->actionOutil_de_seuilage, SIGNAL(triggered()),
                      this, SLOT(showHideGraphicTools()));
 
@@ -146,6 +162,8 @@ void MainWindow::connectSlots(){
 
     QObject::connect(ui->actionReglages, SIGNAL(triggered()),
                      paramWin, SLOT(exec()));
+    QObject::connect(paramWin, SIGNAL(accepted()),
+                     this, SLOT(applyParameters()));
 
     QObject::connect(ui->actionAfficher_les_dessins, SIGNAL(triggered()),
                      this, SLOT(showHideGraphicTools()));
@@ -155,6 +173,10 @@ void MainWindow::connectSlots(){
 
     QObject::connect(ui->viewerRenderer, SIGNAL(mouseClicked(int,int)),
                      _sliceTools, SLOT(placeSlice(int,int)));
+    QObject::connect(ui->viewerRenderer, SIGNAL(mouseDragged(int,int)),
+                     _sliceTools, SLOT(dragSlice(int,int)));
+    QObject::connect(ui->viewerRenderer, SIGNAL(mouseReleased(int,int)),
+                     _sliceTools, SLOT(releaseSlice(int,int)));
 
     QObject::connect(ui->viewerRenderer, SIGNAL(sceneChanged()),
                      _sliceTools, SLOT(update()));
@@ -177,6 +199,13 @@ void MainWindow::connectSlots(){
     QObject::connect(ui->playerBarRwButton, SIGNAL(pressed()),
                      _player, SLOT(first()));
 
+    QObject::connect(ui->playerBarPButton, SIGNAL(clicked()),
+                     _player, SLOT(playPause()));
+    QObject::connect(_player, SIGNAL(playingChanged(bool)),
+                     ui->playerBarPButton, SLOT(setChecked(bool)));
+    QObject::connect(_player, SIGNAL(playbackStats(double,double,int)),
+                     this, SLOT(showPlaybackStats(double,double,int)));
+
     /* Player bar Indice images */
     QObject::connect(_player, SIGNAL(fileListChangedLen(int)),
                      ui->playerFViewLabel, SLOT(setNum(int)));
@@ -186,6 +215,8 @@ void MainWindow::connectSlots(){
                      ui->playerHSlider, SLOT(setValue(int)));
     QObject::connect(_player, SIGNAL(fileListChangedLen(int)),
                      this, SLOT(setPlayerBarRange(int)));
+    QObject::connect(_player, SIGNAL(fileListIdChanged(int)),
+                     this, SLOT(updateCacheStatus()));
 
 
     /* Enabling Components layout */
@@ -203,6 +234,33 @@ void MainWindow::setPlayerBarRange(int max){
     ui->playerHSlider->setRange(1, max);
 }
 
+void MainWindow::applyParameters(){
+    _player->setCacheBudget(paramWin->cacheBudget());
+    _player->setTimeStep(paramWin->playerDelay());
+    _sliceTools->setBand(paramWin->sliceBand());
+}
+
+void MainWindow::showPlaybackStats(double fps, double targetFps, int dropped){
+    ui->statusBar->showMessage(
+        QString("Lecture : %1 / %2 images/s - %3 images sautées")
+            .arg(fps, 0, 'f', 1)
+            .arg(targetFps, 0, 'f', 1)
+            .arg(dropped));
+}
+
+void MainWindow::updateCacheStatus(){
+    const FrameCache& c = _player->cache();
+    const double mb = 1024.0 * 1024.0;
+
+    ui->statusBar->showMessage(
+        QString("Cache : %1 images, %2 / %3 Mo - %4 succès, %5 échecs")
+            .arg(c.size())
+            .arg(c.bytes() / mb, 0, 'f', 1)
+            .arg(c.budget() / mb, 0, 'f', 0)
+            .arg(c.hits())
+            .arg(c.misses()));
+}
+
 void MainWindow::showHideGraphicTools(){
 
     if (ui->actionOutil_de_coupe_verticale->isChecked()
@@ -211,12 +269,16 @@ void MainWindow::showHideGraphicTools(){
     else
         ui->viewerRenderer->hideTools();
 
+    // La coupe oblique utilise le graphe horizontal
+    bool oblique = ui->actionOutil_de_coupe_oblique->isChecked();
+    _sliceTools->setOblique(oblique);
+
     if (ui->actionOutil_de_coupe_verticale->isChecked())
         ui->viewerSliceToolV->show();
     else
         ui->viewerSliceToolV->hide();
 
-    if (ui->actionOutil_de_coupe_horizontale->isChecked())
+    if (ui->actionOutil_de_coupe_horizontale->isChecked() || oblique)
         ui->viewerSliceToolH->show();
     else
         ui->viewerSliceToolH->hide();
@@ -6,7 +6,9 @@ Parameters::Parameters(QWidget *parent) :
     ui(new Ui::Parameters),
     _colorDialog(new QColorDialog),
     _playerDelay(100),
-    _annotColor(QColor(Qt::red))
+    _annotColor(QColor(Qt::red)),
+    _cacheBudget(512),
+    _sliceBand(1)
 {
     ui->setupUi(this);
     resetUi();
@@ -43,6 +45,8 @@ void
 Parameters::accept(){
     _playerDelay = ui->pSpeedSlider->value();
     _annotColor = ui->aColorRender->palette().window().color();
+    _cacheBudget = ui->pCacheSpinBox->value();
+    _sliceBand = ui->sBandSpinBox->value();
     done(QDialog::Accepted);
 }
 
@@ -106,6 +110,9 @@ Parameters::resetUi(){
     p.setColor(QPalette::Background, _annotColor);
     ui->aColorRender->setPalette(p);
     ui->aColorEdit->setText(_annotColor.name());
+
+    ui->pCacheSpinBox->setValue(_cacheBudget);
+    ui->sBandSpinBox->setValue(_sliceBand);
 }
 
 /*****************
@@ -114,10 +121,20 @@ Parameters::resetUi(){
 
 const int&
 Parameters::playerDelay() const {
-    return playerDelay();
+    return _playerDelay;
 }
 
 const QColor&
 Parameters::annotColor() const {
-    return annotColor();
+    return _annotColor;
+}
+
+const int&
+Parameters::cacheBudget() const {
+    return _cacheBudget;
+}
+
+const int&
+Parameters::sliceBand() const {
+    return _sliceBand;
 }
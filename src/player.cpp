@@ -12,9 +12,14 @@ Player::Player(ViewerCVGl *view, int timeStep, QWidget *parent) :
     _fileDialog(new QFileDialog),
     _dirDialog(new QFileDialog),
     _viewer(view),
+    _loader(new FrameLoader(this)),
     _timeStep(timeStep),
+    _currentId(0),
+    _shownId(-1),
     _playing(false),
-    _init(false)
+    _init(false),
+    _playStartId(0), _playTarget(0),
+    _playedFrames(0), _droppedFrames(0)
 {
     _dirName = "N/A";
 
@@ -35,6 +40,13 @@ Player::Player(ViewerCVGl *view, int timeStep, QWidget *parent) :
 
     QObject::connect(_dirDialog, SIGNAL(fileSelected(QString)),
             this, SLOT(openDirectory(QString)));
+
+    QObject::connect(_loader, SIGNAL(frameReady(int)),
+            this, SLOT(frameReady(int)));
+
+    _playTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&_playTimer, SIGNAL(timeout()),
+            this, SLOT(playTick()));
 }
 
 Player::~Player(){
@@ -84,6 +96,7 @@ Player::openFiles(const QStringList &fileNames){
         openFile(fileNames[0]);
     }
     else{
+        if (_playing)  playPause();
 
         _fileNames.clear();
         for (int i=0; i<fileNames.size(); i++){
@@ -91,11 +104,12 @@ Player::openFiles(const QStringList &fileNames){
             std::cout << "   " << fileNames[i].toStdString() << std::endl;
         }
 
-        createBuffer();
-        _currentId = 0;
+        _loader->setFileNames(_fileNames);
+        _shownId = -1;
+        _init = true;
 
         emit fileListChangedLen(_fileNames.size());
-        emit fileListIdChanged(1);
+        showFrame(0);
     }
     return true;
 }
@@ -105,6 +119,7 @@ bool
 Player::openFile(const QString &fileName){
     std::cout << "Open File " << std::endl;
     _fileNames.append(fileName);
+    _loader->appendFileName(fileName);
 
     emit fileListChangedLen(_fileNames.size());
     return true;
@@ -113,10 +128,12 @@ Player::openFile(const QString &fileName){
 
 void
 Player::clearFileList(){
+    if (_playing)  playPause();
     _fileNames.clear();
     _dirName = "N/A";
     _currentId = 0;
-    _curBufferId = 1;
+    _shownId = -1;
+    _loader->setFileNames(_fileNames);
 
     emit fileListChangedLen(0);
     emit fileListIdChanged(0);
@@ -132,78 +149,67 @@ Player::currentId(){
     return _currentId;
 }
 
-void
-Player::setCurrent(const int &id){
-    if (id >= 0 && id < _fileNames.size()){
-        _buffer[_curBufferId] = cv::imread(_fileNames[id].toStdString());
-    }
+int
+Player::shownId(){
+    return _shownId;
 }
 
-
-void
-Player::setNext(const int &id){
-    if (id >= 0 && id < _fileNames.size()){
-        _buffer[nxtBufferId()] = cv::imread(_fileNames[id].toStdString());
-    }
+const QVector<QString>&
+Player::fileNames() const{
+    return _fileNames;
 }
 
-
-void
-Player::setPrevious(const int &id){
-    if (id >= 0 && id < _fileNames.size()){
-        _buffer[prvBufferId()] = cv::imread(_fileNames[id].toStdString());
-    }
+const FrameCache&
+Player::cache() const{
+    return _loader->cache();
 }
 
 
-
-
 /********************* SLOTS **********************/
 
 void
 Player::nextImg(){
     // Si l'image demandée existe
     if (_currentId < _fileNames.size() - 1){
-        _currentId++;
-        _curBufferId = nxtBufferId();
-
-        // Si il y a une image suivante :
-        if (_currentId < _fileNames.size()){
-            setNext(_currentId + 1);
-        }
-
-        // On affiche
-        _viewer->showImage(_buffer[_curBufferId]);
-
-        emit fileListIdChanged(_currentId + 1);
+        showFrame(_currentId + 1);
     }
 }
 
 void
 Player::previousImg(){
     if (_currentId > 0){
-        _currentId--;
-        _curBufferId = prvBufferId();
-
-        if (_currentId > 0){
-            setPrevious(_currentId - 1);
-        }
-
-        _viewer->showImage(_buffer[_curBufferId]);
-
-        emit fileListIdChanged(_currentId + 1);
+        showFrame(_currentId - 1);
     }
 }
 
 void
 Player::playPause(){
-
+    if (_playing){
+        _playTimer.stop();
+        _playing = false;
+        emit playingChanged(false);
+    }
+    else if (_currentId < _fileNames.size() - 1){
+        _playing = true;
+        _playStartId = _currentId;
+        _playTarget = _currentId;
+        _playedFrames = 0;
+        _droppedFrames = 0;
+
+        _playClock.start();
+        _playTimer.start(_timeStep);
+        emit playingChanged(true);
+    }
+    else{
+        emit playingChanged(false); // Rien à lire
+    }
 }
 
 
 void
 Player::stop(){
-
+    if (_playing)  playPause();
+    if (!_fileNames.isEmpty())  first();
 }
 
 
@@ -221,81 +227,113 @@ Player::rewind(){
 
 void
 Player::first(){
-    _currentId = 0;
-    setCurrent(0);
-    setPrevious(0);
-    if (_fileNames.size() > 1)
-        setNext(1);
-    else
-        setNext(0);
-
-    _viewer->showImage(_buffer[_curBufferId]);
-    emit fileListIdChanged(_currentId + 1);
+    showFrame(0);
 }
 
 
 void
 Player::last(){
-    _currentId = _fileNames.size() - 1;
-    setCurrent(_currentId);
-    setNext(_currentId);
-    if(_currentId > 0)
-        setPrevious(_currentId - 1);
-    else
-        setPrevious(0);
-
-    _viewer->showImage(_buffer[_curBufferId]);
-    emit fileListIdChanged(_currentId + 1);
+    showFrame(_fileNames.size() - 1);
 }
 
 
 void
 Player::setTimeStep(int ts){
+    if (ts <= 0)  return;
     _timeStep = ts;
+
+    // La cadence repart de l'image courante
+    if (_playing){
+        _playStartId = _currentId;
+        _playedFrames = 0;
+        _droppedFrames = 0;
+        _playClock.restart();
+        _playTimer.setInterval(_timeStep);
+    }
+}
+
+
+void
+Player::setPrefetchWindow(int ahead, int behind){
+    _loader->setWindow(ahead, behind);
+}
+
+void
+Player::setCacheBudget(int mb){
+    _loader->setCacheBudget(qint64(mb) * 1024 * 1024);
 }
 
 
 /************************** PROTECTED **********************/
 
 void
-Player::createBuffer(){
-    _buffer.resize(3);
+Player::showFrame(int id){
+    if (id < 0 || id >= _fileNames.size())  return;
 
-    cv::Mat src;
+    // Déplacement manuel pendant la lecture : la lecture s'arrête, sinon
+    // l'image ne serait jamais affichée (frameReady) et playTick
+    // reviendrait à l'image attendue par l'horloge
+    if (_playing)  playPause();
 
-    auto start = std::chrono::system_clock::now();
-    src = cv::imread(_fileNames[0].toStdString());
-    _viewer->showImage(src);
-    auto end = std::chrono::system_clock::now();
-    std::chrono::duration<double> diff = end - start;
+    _currentId = id;
+    _loader->prefetch(id);
 
-    // TODO minimiser le timestep des parametres
-    std::cout << "time : " << diff.count() << std::endl;
+    // Si l'image est déjà décodée, elle est affichée immédiatement
+    frameReady(id);
+}
 
-    _buffer[1] = src;
-    _buffer[0] = src;
 
-    _currentId = 0;
-    _curBufferId = 1;
+void
+Player::frameReady(int id){
+    Frame img;
 
-    emit fileListIdChanged(1);
-    _init = true;
+    // Pendant la lecture, c'est playTick() qui décide de l'affichage
+    if (_playing)  return;
 
-    if (_fileNames.size() > 1)
-        setNext(1);
-    else
-        setNext(0);
-}
+    // Seule l'image demandée en dernier est affichée
+    if (id != _currentId || !_loader->frame(id, img))  return;
 
+    _viewer->showFrame(img);
+    _shownId = id;
 
-int
-Player::nxtBufferId(){
-    int res = _curBufferId < 2 ? (_curBufferId +1) : 0;
-    return res;
+    emit fileListIdChanged(_currentId + 1);
 }
 
-int
-Player::prvBufferId(){
-    int res = _curBufferId > 0 ? (_curBufferId -1) : 2;
-    return res;
+
+void
+Player::playTick(){
+    int last = _fileNames.size() - 1;
+    qint64 elapsed = _playClock.elapsed();
+
+    // Image attendue à cet instant
+    int target = _playStartId + int(elapsed / _timeStep);
+    if (target > last)  target = last;
+
+    if (target != _playTarget){
+        _playTarget = target;
+        _loader->prefetch(target);
+    }
+
+    // On affiche l'image décodée la plus proche de la cible, sans revenir
+    // en arrière : les images non décodées à temps sont sautées
+    Frame img;
+    int id = target;
+    while (id > _currentId && !_loader->frame(id, img))
+        id--;
+
+    if (id > _currentId){
+        _droppedFrames += id - _currentId - 1;
+        _playedFrames++;
+        _currentId = id;
+
+        _viewer->showFrame(img);
+        _shownId = id;
+        emit fileListIdChanged(_currentId + 1);
+
+        double fps = (elapsed > 0) ? _playedFrames * 1000.0 / elapsed : 0.0;
+        emit playbackStats(fps, 1000.0 / _timeStep, _droppedFrames);
+    }
+
+    if (_currentId >= last)
+        playPause(); // Fin de la liste
 }
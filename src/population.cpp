@@ -5,19 +5,61 @@
 #include <QComboBox>
 #include <QPushButton>
 #include <QTableWidget>
+#include <QLabel>
+#include <QtConcurrentMap>
+#include <QFileInfo>
+#include <QDir>
 
 #include "include/population.h"
 
+
+/**
+ * @brief Foncteur de comptage d'un fichier, exécuté par les threads
+ * de QtConcurrent
+ */
+struct _CountFile {
+    typedef int result_type;
+
+    _CountFile(const CellCounter::Params& p, ResultJournal* j, QAtomicInt* r) :
+        counter(p), hash(p.hash()), journal(j), resumed(r) {}
+
+    int operator()(const QString& fileName) const {
+        // Image déjà comptée avec ces paramètres lors d'un comptage précédent
+        int n;
+        if (journal->find(fileName, hash, n)){
+            resumed->fetchAndAddRelaxed(1);
+            return n;
+        }
+
+        n = counter.countFile(fileName.toStdString());
+        if (n >= 0)  journal->append(fileName, hash, n);
+        return n;
+    }
+
+    CellCounter counter;
+    uint64_t hash;
+    ResultJournal* journal;
+    QAtomicInt* resumed;
+};
+
+
+const char* const Population::JOURNAL_NAME = "comptage.journal";
+
+
 Population::Population(MainWindow* w, QWidget* ui, ViewerCVGl *v, Player *p) :
     Component(w,ui),
     _viewer(v),
     _player(p),
-    _invThresh(true),  _thresh(0), _contrast(1.0), _lumin(0),
+    _invThresh(true),  _thresh(0), _threshMode(CellCounter::MANUAL),
+    _histValid(false), _contrast(1.0), _lumin(0),
     _eltSize(1), _init(false), _eltShape(cv::MORPH_ELLIPSE),
     _threshEn(false){
+    updateLut();
 }
 
 Population::~Population(){
+    _countWatcher.cancel();
+    _countWatcher.waitForFinished();
 }
 
 
@@ -33,7 +75,9 @@ void Population::enable(){
 }
 
 void Population::copyOrigImage(){
-    _viewer->originImage().copyTo(_origin);
+    // Pas de copie : l'image d'origine n'est jamais modifiée
+    _origin = _viewer->originFrame();
+    _histValid = false;
     render();
     updateTableSize(_player->fileListLength());
 }
@@ -44,7 +88,7 @@ void Population::disable(){
                      this, SLOT(copyOrigImage())
                     );
 
-    _viewer->showImage(_origin);
+    _viewer->showFrame(_origin);
 }
 
 
@@ -64,20 +108,39 @@ void Population::enThresh(bool e){
 
 void Population::setThresh(int t){
     _thresh = t;
-    render();
+    if (_threshMode == CellCounter::MANUAL)  render();
+}
+
+void Population::setThreshMode(int m){
+    _threshMode = (CellCounter::ThreshMode)m;
+
+    // Le curseur affiche le seuil calculé, et ne sert plus qu'en manuel.
+    // Il est mis à jour sans signal : de retour en manuel, on repart du
+    // seuil qu'il affiche
+    QSlider* slider = _ui->findChild<QSlider*>("popSeuilSlider");
+    slider->setEnabled(m == CellCounter::MANUAL);
+    if (m == CellCounter::MANUAL)
+        _thresh = slider->value();
+    if (_threshEn)  render();
 }
 
 
 void Population::setContrast(int c){
     _contrast = double(c) / 100;
+    updateLut();
     render();
 }
 
 void Population::setLumin(int l){
     _lumin = l;
+    updateLut();
     render();
 }
 
+void Population::updateLut(){
+    CellCounter::linearLut(_lut, _contrast, _lumin);
+}
+
 void Population::setEltSize(int s){
     _eltSize = s;
 }
@@ -103,36 +166,46 @@ void Population::invThresh(bool i){
 /* --------- Opérations ---------*/
 
 void Population::render(){
-    linearTransform(_origin);
-
-    if (_threshEn) {
-        int type;
-        if (_invThresh)  type = cv::THRESH_BINARY_INV;
-        else             type = cv::THRESH_BINARY;
-
-        if (_rendered.channels() == 3 || _rendered.channels() == 4)
-            cv::cvtColor(_rendered, _tmpImage, cv::COLOR_RGB2GRAY);
-        else
-            _tmpImage = _rendered;
-        cv::threshold(_tmpImage, _rendered, _thresh, 255, type);
+    // On repart de l'image d'origine : les opérations morphologiques
+    // précédentes sont oubliées
+    _morpho.clear();
+
+    // Deux tampons de sortie en alternance : le résultat est écrit dans
+    // celui qui n'est pas affiché (l'afficheur ne garde que la dernière
+    // image montrée), puis échangé avec l'autre. Aucun n'est réalloué
+    // d'un rendu à l'autre ; `_linear` n'est jamais affiché.
+    Frame::detachOutput(_tmpImage);
+    if (_threshEn){
+        cv::LUT(_origin.mat(), _lut, _linear);
+        CellCounter::threshold(_linear, _tmpImage, currentThresh(), _invThresh);
     }
+    else
+        cv::LUT(_origin.mat(), _lut, _tmpImage);
 
-    _viewer->showImage(_rendered);
+    cv::swap(_rendered, _tmpImage);
+    _viewer->showFrame(Frame(_rendered));
 }
 
 
-void Population::linearTransform(const cv::Mat &src){
-    _rendered = cv::Mat::zeros(src.size(), src.type());
+int Population::currentThresh(){
+    if (_threshMode == CellCounter::MANUAL || _origin.isNull())  return _thresh;
 
-    // Contraste et luminosité pour chaque point
-    for (int y=0; y<src.rows; y++){
-      for (int x=0; x<src.cols; x++){
-        for (int c=0; c<src.channels(); c++){
-          _rendered.at<cv::Vec3b>(y,x)[c] =
-           cv::saturate_cast<uchar>(_contrast * (src.at<cv::Vec3b>(y,x)[c]) + _lumin);
-        }
-      }
+    // Une passe sur l'image par image affichée ; les changements de
+    // contraste, de luminosité ou d'inversion réutilisent l'histogramme
+    if (!_histValid){
+        CellCounter::histogram(_origin.gray(), _hist);
+        _histValid = true;
     }
+
+    std::vector<int> mapped;
+    CellCounter::mapHistogram(_hist, _lut, mapped);
+    int t = CellCounter::autoThreshold(mapped, _threshMode, _invThresh, _thresh);
+
+    QSlider* slider = _ui->findChild<QSlider*>("popSeuilSlider");
+    slider->blockSignals(true);
+    slider->setValue(t);
+    slider->blockSignals(false);
+    return t;
 }
 
 
@@ -143,56 +216,98 @@ void Population::resetLinear(){
 
 
 void Population::erode(){
-    cv::Point2i center = cv::Point2i(_eltSize, _eltSize);
+    _morpho.push_back(CellCounter::Morpho(CellCounter::ERODE, _eltSize, _eltShape));
 
-    cv::Mat kernel = cv::getStructuringElement(_eltShape,
-                                               cv::Size(2*_eltSize+1, 2*_eltSize+1),
-                                               center);
-    _tmpImage = _rendered;
-
-    cv::erode(_tmpImage, _rendered, kernel, center);
-    _viewer->showImage(_rendered);
+    Frame::detachOutput(_tmpImage);
+    CellCounter::morpho(_rendered, _tmpImage, CellCounter::ERODE, _eltSize, _eltShape);
+    cv::swap(_rendered, _tmpImage);
+    _viewer->showFrame(Frame(_rendered));
 }
 
 void Population::dilate(){
-    cv::Point2i center = cv::Point2i(_eltSize, _eltSize);
-
-    cv::Mat kernel = cv::getStructuringElement(_eltShape,
-                                               cv::Size(2*_eltSize+1, 2*_eltSize+1),
-                                               center);
-    _tmpImage = _rendered;
+    _morpho.push_back(CellCounter::Morpho(CellCounter::DILATE, _eltSize, _eltShape));
 
-    cv::dilate(_tmpImage, _rendered, kernel, center);
-    _viewer->showImage(_rendered);
+    Frame::detachOutput(_tmpImage);
+    CellCounter::morpho(_rendered, _tmpImage, CellCounter::DILATE, _eltSize, _eltShape);
+    cv::swap(_rendered, _tmpImage);
+    _viewer->showFrame(Frame(_rendered));
 }
 
 
 void Population::count(){
-    cv::Mat img;
-    if (_rendered.channels() == 3 || _rendered.channels() == 4)
-        cv::cvtColor(_rendered, img, cv::COLOR_RGB2GRAY);
-    else
-        img = _rendered;
-
-    cv::vector<cv::vector<cv::Point> > contours;
+    std::vector<std::vector<cv::Point> > contours;
 
     // Trouver les contours des formes
-    cv::findContours(img, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
-    int n = contours.size();
+    int n = CellCounter::findCells(_rendered, contours);
 
-    // Rendu
+    // Rendu dans le tampon qui n'est pas affiché @see render
+    Frame::detachOutput(_tmpImage);
+    _rendered.copyTo(_tmpImage);
+    cv::swap(_rendered, _tmpImage);
     for (int i=0; i<contours.size(); i++)
         cv::drawContours(_rendered, contours, i, cv::Scalar(255,0,0), 2);
 
 
-    // Màj de l'interface
+    setFrameCount(_player->shownId(), n);
+    _ui->findChild<QLineEdit*>("popLocalLineEdit")->setText(QString::number(n));
+
+    _viewer->showFrame(Frame(_rendered));
+}
+
+
+void Population::countAll(){
+    cancelCountAll();
+
+    QStringList files = _player->fileNames().toList();
+    if (files.isEmpty())  return;
 
-    QLineEdit* localLE = _ui->findChild<QLineEdit*>("popLocalLineEdit");
+    // Journal à côté des images : un comptage interrompu reprend là où
+    // il s'était arrêté
+    QString journal = QFileInfo(files[0]).dir().filePath(JOURNAL_NAME);
+    if (!_journal.isOpen() || _journal.fileName() != journal)
+        if (!_journal.open(journal))
+            std::cerr << "[E] Impossible d'écrire le journal : "
+                      << journal.toStdString() << std::endl;
+    _resumed = 0;
+
+    _ui->findChild<QLabel*>("popDebitLabel")->setText("Comptage en cours...");
+    _countTimer.start();
+    _countWatcher.setFuture(QtConcurrent::mapped(files,
+                                                 _CountFile(countParams(), &_journal, &_resumed)));
+}
+
+void Population::cancelCountAll(){
+    if (_countWatcher.isRunning()){
+        _countWatcher.cancel();
+        _countWatcher.waitForFinished();
+    }
+}
+
+void Population::countAllResult(int id){
+    int n = _countWatcher.resultAt(id);
+    if (n >= 0)  setFrameCount(id, n);
+}
+
+void Population::countAllFinished(){
+    double s = _countTimer.elapsed() / 1000.0;
+    int n = _countWatcher.future().resultCount();
+
+    QString txt = QString::number(n) + " images en " + QString::number(s, 'f', 2)
+            + " s (" + QString::number(s > 0 ? n / s : 0.0, 'f', 1) + " images/s)";
+    if (_resumed.load() > 0)
+        txt += " - " + QString::number(_resumed.load()) + " repris du journal";
+    if (_countWatcher.isCanceled())  txt += " - interrompu";
+
+    _ui->findChild<QLabel*>("popDebitLabel")->setText(txt);
+}
+
+
+void Population::setFrameCount(int id, int n){
     QLineEdit* maxLE = _ui->findChild<QLineEdit*>("popMaxLineEdit");
     QLineEdit* minLE = _ui->findChild<QLineEdit*>("popMinLineEdit");
     QTableWidget* table = _ui->findChild<QTableWidget*>("popTable");
 
-    localLE->setText(QString::number(n));
+    if (id < 0 || id >= table->columnCount())  return;
 
     if (n > maxLE->text().toInt())
         maxLE->setText(QString::number(n));
@@ -200,9 +315,21 @@ void Population::count(){
     if (n < minLE->text().toInt() || minLE->text().toInt() == 0)
         minLE->setText(QString::number(n));
 
-    table->item(0, _player->currentId())->setText(QString::number(n));
+    if (table->item(0, id) == NULL)
+        table->setItem(0, id, new QTableWidgetItem());
+    table->item(0, id)->setText(QString::number(n));
+}
 
-    _viewer->showImage(_rendered);
+CellCounter::Params Population::countParams() const{
+    CellCounter::Params p;
+    p.contrast = _contrast;
+    p.lumin = _lumin;
+    p.threshEn = _threshEn;
+    p.thresh = _thresh;
+    p.invThresh = _invThresh;
+    p.threshMode = _threshMode;
+    p.morpho = _morpho;
+    return p;
 }
 
 /*************************
@@ -216,23 +343,24 @@ void Population::equalize(){
 /*************************
  * XML
  *************************/
-void Population::updateXml(){
-    _data = QDomDocument("Population");
+QString Population::xmlDocType() const{
+    return "Population";
+}
 
-    QDomElement root = _data.createElement("population");
-    _data.appendChild(root);
 
-    QDomElement node;
-    QDomText value;
+void Population::writeXml(QXmlStreamWriter& xml){
+    xml.writeStartElement("population");
+
     QTableWidget* table = _ui->findChild<QTableWidget*>("popTable");
 
     for (int i=0; i<_player->fileListLength(); i++){
-        node = _data.createElement("frame");
-        node.setAttribute("id", i);
-        value = _data.createTextNode(table->item(0,i)->text());
-        node.appendChild(value);
-        root.appendChild(node);
+        xml.writeStartElement("frame");
+        xml.writeAttribute("id", QString::number(i));
+        xml.writeCharacters(table->item(0,i)->text());
+        xml.writeEndElement();
     }
+
+    xml.writeEndElement();
 }
 
 
@@ -297,6 +425,11 @@ void Population::init(){
                      this, SLOT(enThresh(bool))
                     );
 
+    QObject::connect(_ui->findChild<QComboBox*>("popSeuilMode"),
+                     SIGNAL(currentIndexChanged(int)),
+                     this, SLOT(setThreshMode(int))
+                    );
+
     QObject::connect(_ui->findChild<QPushButton*>("popResetLin"),
                      SIGNAL(pressed()),
                      this, SLOT(resetLinear())
@@ -327,6 +460,23 @@ void Population::init(){
                      this, SLOT(count())
                     );
 
+    QObject::connect(_ui->findChild<QPushButton*>("popCompterToutButton"),
+                     SIGNAL(pressed()),
+                     this, SLOT(countAll())
+                    );
+
+    QObject::connect(&_countWatcher, SIGNAL(resultReadyAt(int)),
+                     this, SLOT(countAllResult(int))
+                    );
+
+    QObject::connect(&_countWatcher, SIGNAL(finished()),
+                     this, SLOT(countAllFinished())
+                    );
+
+    QObject::connect(_player, SIGNAL(fileListChangedLen(int)),
+                     this, SLOT(cancelCountAll())
+                    );
+
     QObject::connect(_player, SIGNAL(fileListChangedLen(int)),
                      this, SLOT(updateTableSize(int))
                     );
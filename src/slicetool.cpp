@@ -1,6 +1,7 @@
 
 #include "include/slicetool.h"
 #include <iostream>
+#include <math.h>
 
 /***************
  * Constructeurs
@@ -12,7 +13,9 @@ SliceTool::SliceTool(QCustomPlot *h, QCustomPlot *v, ViewerCVGl* view) :
     _viewer(view),
     _editingH(false),
     _editingV(false),
-    _x(0), _y(0)
+    _x(0), _y(0),
+    _oblique(false), _dragging(false),
+    _band(1)
 {
     /* Connexion des signaux */
     QObject::connect(h, SIGNAL(mousePress(QMouseEvent*)), this, SLOT(editH()));
@@ -47,6 +50,15 @@ SliceTool::SliceTool(QCustomPlot *h, QCustomPlot *v, ViewerCVGl* view) :
 
 bool
 SliceTool::placeSlice(int x, int y){
+    // Début du tracé de la coupe oblique
+    if (_oblique){
+        _a = _viewer->mapToImage(x, y);
+        _b = _a;
+        _dragging = true;
+        _viewer->setSliceSegment(_a, _b, _band);
+        return true;
+    }
+
     bool res = _editingH | _editingV;
 
     if (_editingH){
@@ -69,6 +81,41 @@ SliceTool::placeSlice(int x, int y){
 }
 
 
+void
+SliceTool::dragSlice(int x, int y){
+    if (!_dragging)  return;
+
+    // Le rendu de l'afficheur déclenche update()
+    _b = _viewer->mapToImage(x, y);
+    _viewer->setSliceSegment(_a, _b, _band);
+}
+
+void
+SliceTool::releaseSlice(int x, int y){
+    dragSlice(x, y);
+    _dragging = false;
+}
+
+
+void
+SliceTool::setOblique(bool o){
+    if (o == _oblique)  return;
+
+    _oblique = o;
+    _dragging = false;
+    if (!o)
+        _viewer->hideSliceSegment();
+    update(true, false);
+}
+
+void
+SliceTool::setBand(int band){
+    _band = (band < 1) ? 1 : band;
+    if (_oblique && _a != _b)
+        _viewer->setSliceSegment(_a, _b, _band);
+}
+
+
 void
 SliceTool::editH(){
     _editingH = true;
@@ -81,37 +128,127 @@ SliceTool::editV(){
 
 void
 SliceTool::update(bool h, bool v){
-    if (h || v){
-        QImage img = _viewer->grabFrameBuffer(false);
-        if (h){
-            if (img.size().width() != _hData.size()){
-                _hData.resize(img.size().width());
-                _hTool->xAxis->setRange(0,_hData.size());
-            }
-
-            _hTool->graph(0)->clearData();
-            for(int i=0; i<_hData.size(); i++){
-                _hData[i] = qGray(img.pixel(i, _y)); // en niveaux de gris
-                _hTool->graph(0)->addData(i,_hData[i]);
-            }
-            _hTool->replot();
+    if (h && _oblique){
+        QPointF d = _b - _a;
+        _hTool->xAxis->setRange(0, qMax(1.0, sqrt(d.x()*d.x() + d.y()*d.y())));
+        lineProfile(_viewer->originFrame().gray(), _a, _b, _band, _hKeys, _hData);
+        _hTool->graph(0)->setData(_hKeys, _hData);
+        _hTool->replot();
+    }
+    else if (h){
+        _hTool->xAxis->setRange(0, _viewer->width());
+        profile(true, _y, _hKeys, _hData);
+        _hTool->graph(0)->setData(_hKeys, _hData);
+        _hTool->replot();
+    }
+    if (v){
+        _vTool->yAxis->setRange(0, _viewer->height());
+        profile(false, _x, _vKeys, _vData);
+        _vTool->graph(0)->setData(_vKeys, _vData);
+        _vTool->replot();
+    }
+}
+
+
+void
+SliceTool::profile(bool horizontal, int pos,
+                   QVector<double>& keys, QVector<double>& values) const{
+    keys.resize(0);
+    values.resize(0);
+
+    const cv::Mat& img = _viewer->originFrame().gray();
+    if (img.empty() || img.depth() != CV_8U)  return;
+
+    // Ligne (ou colonne) de l'image sous la ligne de coupe
+    QPointF p = horizontal ? _viewer->mapToImage(0, pos) : _viewer->mapToImage(pos, 0);
+    int line = horizontal ? floor(p.y()) : floor(p.x());
+    int lineNb = horizontal ? img.rows : img.cols;
+    if (line < 0 || line >= lineNb)  return;
+
+    // Parcours de la ligne avec le pas correspondant à la direction
+    const uchar* base;
+    size_t stride;
+    int n;
+    if (horizontal){
+        base = img.ptr<uchar>(line);
+        stride = 1;
+        n = img.cols;
+    }else{
+        base = img.data + line;
+        stride = img.step[0];
+        n = img.rows;
+    }
+
+    // Position dans l'image du pixel i du cadre : origin + i / zoom
+    double origin = horizontal ? p.x() : p.y();
+    double scale = 1.0 / _viewer->zoom();
+    int len = horizontal ? _viewer->width() : _viewer->height();
+
+    keys.reserve(len);
+    values.reserve(len);
+    for (int i=0; i<len; i++){
+        int k = floor(origin + i * scale);
+        if (k < 0 || k >= n)  continue;
+        keys.append(i);
+        values.append(base[k * stride]);
+    }
+}
+
+void
+SliceTool::lineProfile(const cv::Mat& gray, const QPointF& a, const QPointF& b,
+                       int band, QVector<double>& keys, QVector<double>& values){
+    keys.resize(0);
+    values.resize(0);
+    if (gray.empty() || gray.depth() != CV_8U || gray.channels() != 1)  return;
+
+    // Pas d'un pixel le long du segment (u) et perpendiculairement (nrm)
+    double dx = b.x() - a.x();
+    double dy = b.y() - a.y();
+    double len = sqrt(dx*dx + dy*dy);
+    int n = floor(len) + 1;
+    double ux = (len > 0) ? dx / len : 1.0;
+    double uy = (len > 0) ? dy / len : 0.0;
+    double nx = -uy;
+    double ny = ux;
+    double off = (band - 1) / 2.0;
+
+    // Centres des pixels aux coordonnées entières + 0.5
+    double x0 = a.x() - 0.5 - off * nx;
+    double y0 = a.y() - 0.5 - off * ny;
+    int xmax = gray.cols - 1;
+    int ymax = gray.rows - 1;
+
+    keys.reserve(n);
+    values.reserve(n);
+    for (int i=0; i<n; i++){
+        double sum = 0;
+        int cnt = 0;
+        for (int j=0; j<band; j++){
+            double x = x0 + i * ux + j * nx;
+            double y = y0 + i * uy + j * ny;
+            if (x < 0 || y < 0 || x > xmax || y > ymax)  continue;
+
+            // Interpolation bilinéaire
+            int xi = (int)x;
+            int yi = (int)y;
+            double fx = x - xi;
+            double fy = y - yi;
+            int xn = (xi < xmax) ? xi + 1 : xi;
+            const uchar* r0 = gray.ptr<uchar>(yi);
+            const uchar* r1 = gray.ptr<uchar>((yi < ymax) ? yi + 1 : yi);
+
+            sum += (1-fy) * ((1-fx) * r0[xi] + fx * r0[xn])
+                 +    fy  * ((1-fx) * r1[xi] + fx * r1[xn]);
+            cnt++;
         }
-        if (v){
-            if (img.size().height() != _vData.size()){
-                _vData.resize(img.size().height());
-                _vTool->yAxis->setRange(0,_vData.size());
-            }
-
-            _vTool->graph(0)->clearData();
-            for(int i=0; i<_vData.size(); i++){
-                _vData[i] = qGray(img.pixel(_x, i));
-                _vTool->graph(0)->addData(i, _vData[i]);
-            }
-            _vTool->replot();
+        if (cnt > 0){
+            keys.append(i);
+            values.append(sum / cnt);
         }
     }
 }
 
+
 void
 SliceTool::update(){
     update(true, true);
@@ -3,6 +3,15 @@
 #include <QDebug>
 #include <QErrorMessage>
 
+#include <math.h>
+#include <algorithm>
+
+/// Clef d'une tuile dans `_Tiles`
+static inline quint64
+_tileKey(int l, int tx, int ty){
+    return (quint64(l) << 48) | (quint64(ty) << 24) | quint64(tx);
+}
+
 /************************
  * Constructeurs
  ************************/
@@ -11,16 +20,22 @@ ViewerCVGl::ViewerCVGl(QWidget *parent) :
     QGLWidget(parent),
     _showDrawings(false), _showTools(false),
     _sliceToolx(0), _sliceTooly(0),
+    _segmentBand(1), _showSegment(false),
     _SceneChanged(false),
+    _OrigVersion(0), _RenderOrigVersion(0), _RenderProcVersion(0),
+    _TilesOrigVersion(0), _TilesProcVersion(0), _RenderCount(0),
+    _Zoom(1.0), _ViewX(0), _ViewY(0),
+    _FitView(true), _Panning(false),
     _BgColor(QColor::fromRgb(150,150,150)),
     _OutH(0), _OutW(0),
-    _ImgRatio(4.0f/3.0f),
     _PosX(0), _PosY(0)
 {
     _drawings = QImage(0,0, QImage::Format_Mono);
 }
 
-ViewerCVGl::~ViewerCVGl(){}
+ViewerCVGl::~ViewerCVGl(){
+    clearTiles();
+}
 
 
 void ViewerCVGl::setImgProc(EdImageProcessor *p){
@@ -43,7 +58,8 @@ ViewerCVGl::imageHeight() const {
 }
 
 const QImage&
-ViewerCVGl::renderedImage() const {
+ViewerCVGl::renderedImage() {
+    processImage();
     return _RenderQtImg;
 }
 
@@ -52,21 +68,85 @@ ViewerCVGl::originImage() const {
     return _OrigImage;
 }
 
+const Frame&
+ViewerCVGl::originFrame() const {
+    return _OrigFrame;
+}
+
+double
+ViewerCVGl::zoom() const {
+    return _Zoom;
+}
+
+QPointF
+ViewerCVGl::mapToImage(int x, int y) const {
+    return QPointF(_ViewX + x / _Zoom, _ViewY + y / _Zoom);
+}
+
+QPointF
+ViewerCVGl::mapToWidget(double u, double v) const {
+    return QPointF((u - _ViewX) * _Zoom, (v - _ViewY) * _Zoom);
+}
+
 
 /************************
  * Événements
  ************************/
 void
 ViewerCVGl::mousePressEvent(QMouseEvent *event){
-    int imgX, imgY;
+    // Boutons du milieu et droit : déplacement de la vue
+    if (event->button() == Qt::MiddleButton || event->button() == Qt::RightButton){
+        _Panning = true;
+        _PanLast = event->pos();
+        return;
+    }
 
-    imgX = event->x() - _PosX;
-    imgY = event->y() - _PosY;
-    imgX *= ((double)(_OrigImage.cols) / _OutW);
-    imgY *= ((double)(_OrigImage.rows) / _OutH);
+    QPointF p = mapToImage(event->x(), event->y());
 
     emit mouseClicked(event->x(), event->y());
-    emit mouseClickedImage(imgX, imgY);
+    emit mouseClickedImage(floor(p.x()), floor(p.y()));
+}
+
+void
+ViewerCVGl::mouseMoveEvent(QMouseEvent *event){
+    if (!_Panning){
+        if (event->buttons() & Qt::LeftButton)
+            emit mouseDragged(event->x(), event->y());
+        return;
+    }
+
+    QPoint d = event->pos() - _PanLast;
+    _PanLast = event->pos();
+
+    _ViewX -= d.x() / _Zoom;
+    _ViewY -= d.y() / _Zoom;
+    _FitView = false;
+
+    updateLayout();
+    _SceneChanged = true;
+    updateScene();
+}
+
+void
+ViewerCVGl::mouseReleaseEvent(QMouseEvent *event){
+    if (event->button() == Qt::MiddleButton || event->button() == Qt::RightButton)
+        _Panning = false;
+    else if (event->button() == Qt::LeftButton)
+        emit mouseReleased(event->x(), event->y());
+}
+
+void
+ViewerCVGl::mouseDoubleClickEvent(QMouseEvent *event){
+    if (event->button() == Qt::LeftButton)
+        fitToWindow();
+}
+
+void
+ViewerCVGl::wheelEvent(QWheelEvent *event){
+    // Un cran de molette (120) : facteur 1.25
+    double f = pow(1.25, event->delta() / 120.0);
+    setZoom(_Zoom * f, event->x(), event->y());
+    event->accept();
 }
 
 /************************
@@ -104,6 +184,23 @@ ViewerCVGl::setSliceToolY(int y){
     }
 }
 
+void
+ViewerCVGl::setSliceSegment(const QPointF &a, const QPointF &b, int band){
+    _segmentA = a;
+    _segmentB = b;
+    _segmentBand = band;
+    _showSegment = true;
+    _SceneChanged = true;
+    updateScene();
+}
+
+void
+ViewerCVGl::hideSliceSegment(){
+    _showSegment = false;
+    _SceneChanged = true;
+    updateScene();
+}
+
 void ViewerCVGl::showTools(){ _showTools = true; }
 void ViewerCVGl::hideTools(){ _showTools = false; }
 
@@ -136,6 +233,58 @@ ViewerCVGl::reset(){
 }
 
 
+void
+ViewerCVGl::setZoom(double zoom, int x, int y){
+    if (_OrigImage.empty())  return;
+
+    // Entre l'image entière dans 16 pixels et 32 pixels affichés par pixel
+    double zmin = 16.0 / std::max(_OrigImage.cols, _OrigImage.rows);
+    zoom = std::max(zmin, std::min(32.0, zoom));
+
+    // Le point de l'image sous (x,y) reste sous (x,y)
+    QPointF p = mapToImage(x, y);
+    _Zoom = zoom;
+    _ViewX = p.x() - x / _Zoom;
+    _ViewY = p.y() - y / _Zoom;
+    _FitView = false;
+
+    updateLayout();
+    _SceneChanged = true;
+    updateScene();
+}
+
+void
+ViewerCVGl::zoomIn(){
+    setZoom(_Zoom * 1.25, width() / 2, height() / 2);
+}
+
+void
+ViewerCVGl::zoomOut(){
+    setZoom(_Zoom / 1.25, width() / 2, height() / 2);
+}
+
+void
+ViewerCVGl::fitToWindow(){
+    _FitView = true;
+    updateLayout();
+    _SceneChanged = true;
+    updateScene();
+}
+
+void
+ViewerCVGl::centerOn(int x, int y){
+    if (_OrigImage.empty())  return;
+
+    _ViewX = x - width() / (2 * _Zoom);
+    _ViewY = y - height() / (2 * _Zoom);
+    _FitView = false;
+
+    updateLayout();
+    _SceneChanged = true;
+    updateScene();
+}
+
+
 /*** Graphic edition methods ***/
 
 void
@@ -180,6 +329,34 @@ ViewerCVGl::renderTools(){
             glVertex2i(_sliceToolx, size().height());
         glEnd();
     }
+
+    if (_showSegment){
+        int H = size().height();
+        QPointF a = mapToWidget(_segmentA.x(), _segmentA.y());
+        QPointF b = mapToWidget(_segmentB.x(), _segmentB.y());
+
+        glColor3f(1.0,0.0,0.0);
+        glBegin(GL_LINES);
+            glVertex2d(a.x(), H - a.y());
+            glVertex2d(b.x(), H - b.y());
+        glEnd();
+
+        // Bords de la bande moyennée
+        QPointF d = _segmentB - _segmentA;
+        double len = sqrt(d.x()*d.x() + d.y()*d.y());
+        if (_segmentBand > 1 && len > 0){
+            QPointF n(-d.y() / len, d.x() / len);
+            n *= (_segmentBand - 1) / 2.0 * _Zoom;
+
+            glColor3f(1.0,0.6,0.0);
+            glBegin(GL_LINES);
+                glVertex2d(a.x() + n.x(), H - (a.y() + n.y()));
+                glVertex2d(b.x() + n.x(), H - (b.y() + n.y()));
+                glVertex2d(a.x() - n.x(), H - (a.y() - n.y()));
+                glVertex2d(b.x() - n.x(), H - (b.y() - n.y()));
+            glEnd();
+        }
+    }
 }
 
 
@@ -201,25 +378,34 @@ void ViewerCVGl::resizeGL(int width, int height)
 
     glMatrixMode(GL_MODELVIEW);
 
-    // ---> Scaled Image Sizes
-    _OutH = width/_ImgRatio;
-    _OutW = width;
+    updateLayout();
 
-    if(_OutH>height)
-    {
-        _OutW = height*_ImgRatio;
-        _OutH = height;
-    }
+    _SceneChanged = true;
 
-    emit imageSizeChanged( _OutW, _OutH );
-    // <--- Scaled Image Sizes
+    updateScene();
+}
 
-    _PosX = (width-_OutW)/2;
-    _PosY = (height-_OutH)/2;
+void ViewerCVGl::updateLayout()
+{
+    if (_OrigImage.empty())  return;
 
-    _SceneChanged = true;
+    double cols = _OrigImage.cols;
+    double rows = _OrigImage.rows;
 
-    updateScene();
+    // Image entière, centrée dans le cadre
+    if (_FitView){
+        _Zoom = std::min(width() / cols, height() / rows);
+        if (_Zoom <= 0)  _Zoom = 1.0;
+        _ViewX = - (width() / _Zoom - cols) / 2;
+        _ViewY = - (height() / _Zoom - rows) / 2;
+    }
+
+    _OutW = cols * _Zoom;
+    _OutH = rows * _Zoom;
+    _PosX = - _ViewX * _Zoom;
+    _PosY = - _ViewY * _Zoom;
+
+    emit imageSizeChanged( _OutW, _OutH );
 }
 
 void ViewerCVGl::updateScene()
@@ -248,73 +434,246 @@ void ViewerCVGl::renderImage()
 
     glClear(GL_COLOR_BUFFER_BIT);
 
-    if (!_RenderQtImg.isNull())
-    {
-        glLoadIdentity();
+    if (_OrigImage.empty())
+        return;
+
+    // Tuiles périmées : nouvelle image ou nouveaux paramètres de traitement
+    if (_TilesOrigVersion != _OrigVersion || _TilesProcVersion != _imgProc->version()){
+        clearTiles();
+        _TilesOrigVersion = _OrigVersion;
+        _TilesProcVersion = _imgProc->version();
+    }
+    _RenderCount++;
 
-        QImage image; // the image rendered
+    int l = levelForZoom();
+    const cv::Mat& lvl = level(l);
 
-        glPushMatrix();
-        {
-            int imW = _RenderQtImg.width();
-            int imH = _RenderQtImg.height();
+    // Pixels de l'image d'origine par pixel du niveau
+    double sx = (double)_OrigImage.cols / lvl.cols;
+    double sy = (double)_OrigImage.rows / lvl.rows;
 
-            // The image is to be resized to fit the widget?
-            if( imW != this->size().width() &&
-                    imH != this->size().height() )
-            {
+    // Partie visible, en pixels du niveau
+    QPointF tl = mapToImage(0, 0);
+    QPointF br = mapToImage(width(), height());
+    int x0 = std::max(0, (int)floor(tl.x() / sx));
+    int y0 = std::max(0, (int)floor(tl.y() / sy));
+    int x1 = std::min(lvl.cols, (int)ceil(br.x() / sx));
+    int y1 = std::min(lvl.rows, (int)ceil(br.y() / sy));
 
-                image = _RenderQtImg.scaled( //this->size(),
-                                             QSize(_OutW,_OutH),
-                                             Qt::IgnoreAspectRatio,
-                                             Qt::SmoothTransformation
-                                             );
+    glLoadIdentity();
+    glPushMatrix();
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0, 1.0, 1.0);
+
+    int H = height();
+    for (int ty = y0 / TILE_SIZE; ty * TILE_SIZE < y1; ty++){
+        for (int tx = x0 / TILE_SIZE; tx * TILE_SIZE < x1; tx++){
+            GLuint tex = tile(l, tx, ty);
+            if (tex == 0)  continue;
+            const _Tile& t = _Tiles[_tileKey(l, tx, ty)];
+
+            // Coins de la tuile dans le cadre (y vers le haut pour OpenGL)
+            QPointF a = mapToWidget(tx * TILE_SIZE * sx, ty * TILE_SIZE * sy);
+            QPointF b = mapToWidget((tx * TILE_SIZE + t.w) * sx,
+                                    (ty * TILE_SIZE + t.h) * sy);
+            double s = (double)t.w / TILE_SIZE;
+            double r = (double)t.h / TILE_SIZE;
+
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glBegin(GL_QUADS);
+                glTexCoord2d(0, 0);  glVertex2d(a.x(), H - a.y());
+                glTexCoord2d(s, 0);  glVertex2d(b.x(), H - a.y());
+                glTexCoord2d(s, r);  glVertex2d(b.x(), H - b.y());
+                glTexCoord2d(0, r);  glVertex2d(a.x(), H - b.y());
+            glEnd();
+        }
+    }
 
-                //qDebug() << tr( "Image size: (%1x%2)").arg(imW).arg(imH);
-            }
-            else
-                image = _RenderQtImg;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glPopMatrix();
 
-            // ---> Centering image in draw area
-            glRasterPos2i( _PosX, _PosY );
-            // <--- Centering image in draw area
+    evictTiles();
 
-            imW = image.width();
-            imH = image.height();
+    renderTools();
+
+    // end
+    glFlush();
+
+    // Tell everyone the scene changed
+    emit sceneChanged();
+}
 
-            glDrawPixels( imW, imH, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
-        }
-        glPopMatrix();
 
-        renderTools();
+const cv::Mat&
+ViewerCVGl::level(int l){
+    if (_Pyramid.empty())
+        _Pyramid.push_back(_OrigImage);
+
+    while ((int)_Pyramid.size() <= l){
+        cv::Mat down;
+        cv::pyrDown(_Pyramid.back(), down);
+        _Pyramid.push_back(down);
+    }
+    return _Pyramid[l];
+}
 
-        // end
-        glFlush();
+
+int
+ViewerCVGl::levelForZoom() const {
+    // Plus grand niveau l tel que 2^l <= 1/zoom, la dernière tuile
+    // d'un niveau couvrant au moins l'image entière
+    int l = 0;
+    int side = std::max(_OrigImage.cols, _OrigImage.rows);
+    while (_Zoom * (1 << (l+1)) <= 1.0 && (side >> (l+1)) >= TILE_SIZE / 2)
+        l++;
+    return l;
+}
 
 
-        // Tell everyone the scene changed
-        emit sceneChanged();
+GLuint
+ViewerCVGl::tile(int l, int tx, int ty){
+    quint64 key = _tileKey(l, tx, ty);
+    QHash<quint64, _Tile>::iterator it = _Tiles.find(key);
+    if (it != _Tiles.end()){
+        it->lastUsed = _RenderCount;
+        return it->tex;
     }
+
+    const cv::Mat& lvl = level(l);
+    cv::Rect roi(tx * TILE_SIZE, ty * TILE_SIZE, 0, 0);
+    roi.width = std::min(TILE_SIZE, lvl.cols - roi.x);
+    roi.height = std::min(TILE_SIZE, lvl.rows - roi.y);
+
+    // Les traitements ne portent que sur la tuile, agrandie du voisinage
+    // lu par la morphologie (pas de raccord visible entre tuiles). Le
+    // niveau l est réduit 2^l fois : l'élément structurant aussi
+    double scale = 1.0 / (1 << l);
+    int m = _imgProc->margin(scale);
+    cv::Rect ext = cv::Rect(roi.x - m, roi.y - m, roi.width + 2*m, roi.height + 2*m)
+                 & cv::Rect(0, 0, lvl.cols, lvl.rows);
+    cv::Mat img = _imgProc->process(lvl(ext), scale)
+            (cv::Rect(roi.x - ext.x, roi.y - ext.y, roi.width, roi.height));
+    cv::Mat rgba;
+    if (img.channels() == 3)
+        cv::cvtColor(img, rgba, cv::COLOR_BGR2RGBA);
+    else if (img.channels() == 1)
+        cv::cvtColor(img, rgba, cv::COLOR_GRAY2RGBA);
+    else if (img.channels() == 4)
+        cv::cvtColor(img, rgba, cv::COLOR_BGRA2RGBA);
+    else
+        return 0;
+
+    _Tile t;
+    t.w = rgba.cols;
+    t.h = rgba.rows;
+    t.lastUsed = _RenderCount;
+
+    // Texture de taille fixe (puissance de deux), la tuile en occupe le
+    // coin. Le reste répète la dernière ligne et la dernière colonne :
+    // l'interpolation linéaire au bord de l'image ne mélange pas de
+    // texels indéfinis
+    if (t.w < TILE_SIZE || t.h < TILE_SIZE){
+        cv::Mat padded;
+        cv::copyMakeBorder(rgba, padded, 0, TILE_SIZE - t.h, 0, TILE_SIZE - t.w,
+                           cv::BORDER_REPLICATE);
+        rgba = padded;
+    }
+
+    glGenTextures(1, &t.tex);
+    glBindTexture(GL_TEXTURE_2D, t.tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, TILE_SIZE, TILE_SIZE, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, rgba.data);
+
+    _Tiles.insert(key, t);
+    return t.tex;
 }
 
+
+void
+ViewerCVGl::clearTiles(){
+    if (_Tiles.isEmpty())  return;
+
+    makeCurrent();
+    for (QHash<quint64, _Tile>::iterator it = _Tiles.begin(); it != _Tiles.end(); ++it)
+        glDeleteTextures(1, &(it->tex));
+    _Tiles.clear();
+}
+
+
+void
+ViewerCVGl::evictTiles(){
+    if (_Tiles.size() <= MAX_TILES)  return;
+
+    // Les tuiles du rendu courant sont gardées, même au delà de MAX_TILES
+    std::vector<std::pair<quint64, quint64> > old; // (lastUsed, clef)
+    for (QHash<quint64, _Tile>::iterator it = _Tiles.begin(); it != _Tiles.end(); ++it)
+        if (it->lastUsed != _RenderCount)
+            old.push_back(std::make_pair(it->lastUsed, it.key()));
+    std::sort(old.begin(), old.end());
+
+    for (size_t i=0; i<old.size() && _Tiles.size() > MAX_TILES; i++){
+        GLuint tex = _Tiles[old[i].second].tex;
+        glDeleteTextures(1, &tex);
+        _Tiles.remove(old[i].second);
+    }
+}
+
+
 bool ViewerCVGl::showImage( cv::Mat image )
 {
-    if (image.data == NULL){
+    return showFrame(Frame(image.clone()));
+}
+
+
+bool ViewerCVGl::showFrame( const Frame& frame )
+{
+    if (frame.isNull()){
         QErrorMessage dial;
         dial.showMessage("Format d'image non pris en charge.");
         dial.exec();
     }
 
-    image.copyTo(_OrigImage);
-    _ImgRatio = (float)image.cols/(float)image.rows;
+    // Nouvelle taille d'image : la vue est réinitialisée, sinon le zoom
+    // et la position sont conservés d'une image à l'autre
+    if (frame.mat().size() != _OrigImage.size())
+        _FitView = true;
 
-    bool res = drawImage();
+    _OrigFrame = frame;
+    _OrigImage = _OrigFrame.mat();
+    _OrigVersion++;
+    _Pyramid.clear();
+
+    // resizeGL() se charge de redessiner la scène
     resizeGL(width(), height());
-    return res;
+    return !_OrigImage.empty();
 }
 
 
 bool ViewerCVGl::drawImage(){
+    if (_OrigImage.empty())
+        return false;
+
+    // Les tuiles sont recalculées au rendu si les paramètres ont changé
+    _SceneChanged = true;
+    updateScene();
+    return true;
+}
+
+
+bool ViewerCVGl::processImage(){
+    // Rendu déjà calculé pour cette image et ces paramètres
+    if (!_RenderQtImg.isNull()
+            && _RenderOrigVersion == _OrigVersion
+            && _RenderProcVersion == _imgProc->version()){
+        return true;
+    }
+
     // On applique les traitements éventuels à l'image d'origine
     cv::Mat img = _imgProc->process(_OrigImage);
 
@@ -322,20 +681,21 @@ bool ViewerCVGl::drawImage(){
         _RenderQtImg = QImage((const unsigned char*)(img.data),
                               img.cols, img.rows,
                               img.step, QImage::Format_RGB888).rgbSwapped();
-    else if( img.channels() == 1)
+    else if( img.channels() == 1){
+        static QVector<QRgb> grays;
+        if (grays.isEmpty())
+            for (int i=0; i<256; i++)  grays.append(qRgb(i,i,i));
+
         _RenderQtImg = QImage((const unsigned char*)(img.data),
                               img.cols, img.rows,
-                              img.step, QImage::Format_Indexed8);
+                              img.step, QImage::Format_Indexed8).copy();
+        _RenderQtImg.setColorTable(grays);
+    }
     else
         return false;
 
-    _RenderQtImg = QGLWidget::convertToGLFormat(_RenderQtImg);
-
-    _SceneChanged = true;
-
-    updateScene();
+    _RenderOrigVersion = _OrigVersion;
+    _RenderProcVersion = _imgProc->version();
 
     return true;
 }
-
-